@@ -0,0 +1,146 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//allocation accounting. building with AUTOGIT_ALLOC_STATS replaces the global allocator with a counting one,
+//without it every counter stays zero and nothing is reported.
+namespace alloc_stats {
+#if defined(AUTOGIT_ALLOC_STATS)
+	constexpr bool enabled = true;
+#else
+	constexpr bool enabled = false;
+#endif
+
+	enum class phase {
+		other,
+		scan,
+		apply,
+		git,
+		count
+	};
+	constexpr auto phase_string(phase phase) {
+		switch (phase) {
+		case phase::other: return "other";
+		case phase::scan: return "scan";
+		case phase::apply: return "apply";
+		case phase::git: return "git";
+		default: return "";
+		}
+	}
+
+	struct counters {
+		std::atomic<qpl::u64> count = 0u;
+		std::atomic<qpl::u64> bytes = 0u;
+	};
+	counters phases[static_cast<qpl::size>(phase::count)];
+	//worker threads of parallel_for start in "other", so fanned out work is only counted in the totals.
+	thread_local phase current = phase::other;
+
+	void record(std::size_t size) {
+		auto& counter = phases[static_cast<qpl::size>(current)];
+		counter.count.fetch_add(1u, std::memory_order_relaxed);
+		counter.bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	struct totals {
+		qpl::u64 count = 0u;
+		qpl::u64 bytes = 0u;
+
+		totals operator-(const totals& other) const {
+			return totals{ this->count - other.count, this->bytes - other.bytes };
+		}
+		std::string string() const {
+			return qpl::to_string(this->count, " allocations, ", qpl::memory_size_string(this->bytes));
+		}
+	};
+	totals take(phase phase) {
+		auto& counter = phases[static_cast<qpl::size>(phase)];
+		return totals{ counter.count.load(), counter.bytes.load() };
+	}
+	totals take() {
+		totals result;
+		for (qpl::size i = 0u; i < static_cast<qpl::size>(phase::count); ++i) {
+			result.count += phases[i].count.load();
+			result.bytes += phases[i].bytes.load();
+		}
+		return result;
+	}
+	std::array<totals, static_cast<qpl::size>(phase::count)> take_all() {
+		std::array<totals, static_cast<qpl::size>(phase::count)> result;
+		for (qpl::size i = 0u; i < result.size(); ++i) {
+			result[i] = take(static_cast<phase>(i));
+		}
+		return result;
+	}
+
+	//counts everything this thread allocates until the scope ends into phase.
+	struct scope {
+		phase previous;
+
+		scope(phase phase) : previous(current) {
+			current = phase;
+		}
+		~scope() {
+			current = this->previous;
+		}
+	};
+}
+
+#if defined(AUTOGIT_ALLOC_STATS)
+void* operator new(std::size_t size) {
+	alloc_stats::record(size);
+	if (auto pointer = std::malloc(size ? size : 1u)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+	alloc_stats::record(size);
+	auto alignment = static_cast<std::size_t>(align);
+#if defined(_WIN32)
+	if (auto pointer = _aligned_malloc(size ? size : 1u, alignment)) {
+#else
+	if (auto pointer = std::aligned_alloc(alignment, (std::max(size, alignment) + alignment - 1u) / alignment * alignment)) {
+#endif
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+	return operator new(size, align);
+}
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+void operator delete[](void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+void operator delete(void* pointer, std::align_val_t) noexcept {
+#if defined(_WIN32)
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+void operator delete[](void* pointer, std::align_val_t align) noexcept {
+	operator delete(pointer, align);
+}
+void operator delete(void* pointer, std::size_t, std::align_val_t align) noexcept {
+	operator delete(pointer, align);
+}
+void operator delete[](void* pointer, std::size_t, std::align_val_t align) noexcept {
+	operator delete(pointer, align);
+}
+#endif
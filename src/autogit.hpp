@@ -1,35 +1,95 @@
 #pragma once
 
 #include "autogit_directory.hpp"
+#include "prefetch.hpp"
+#include "speculation.hpp"
+#include "matcher.hpp"
 #include <qpl/qpl.hpp>
+#include <future>
 
 struct autogit {
 	std::vector<autogit_directory> directories;
+	directory_index index;
+	std::shared_future<void> discovery;
+	//messages of the background discovery, shown with the directory list once the next command waits for it
+	//instead of over the prompt the user may be typing at.
+	std::vector<std::string> discovery_notes;
+	mutable std::atomic_bool discovery_shown = false;
 
-	void find_directory(qpl::filesys::path path) {
+	~autogit() {
+		if (this->discovery.valid()) {
+			this->discovery.wait();
+		}
+		speculation::background.stop();
+	}
+
+	static std::string relative_to(std::string root, std::string path) {
+		std::replace(root.begin(), root.end(), '\\', '/');
+		std::replace(path.begin(), path.end(), '\\', '/');
+		if (!root.empty() && root.back() != '/') {
+			root.push_back('/');
+		}
+		if (path.size() >= root.size() && qpl::string_equals_ignore_case(path.substr(0u, root.size()), root)) {
+			return path.substr(root.size());
+		}
+		return path;
+	}
+	//a mirror keeps the directory's place below its location root, so directories with the same name don't share one.
+	//a directory that is the location root itself, or outside of it, is mirrored under its name.
+	static std::string mirror_key(const autogit_directory& directory) {
+		auto& relative = directory.relative_path;
+		if (relative.empty() || relative.starts_with('/') || relative.find(':') != std::string::npos) {
+			return directory.directory_name + '/';
+		}
+		return relative;
+	}
+	bool mirror_used(const std::string& root) const {
+		for (auto& directory : this->directories) {
+			for (auto& used : directory.mirror_roots) {
+				if (qpl::string_equals_ignore_case(used, root)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	void find_directory(qpl::filesys::path path, const location_path& options) {
 		if (path.string().starts_with("//")) {
 			return;
 		}
 		path.ensure_directory_backslash();
 		if (!path.exists()) {
-			qpl::println('\\', path, "\\ doesn't exist.");
+			this->discovery_notes.push_back(qpl::to_string('\\', path, "\\ doesn't exist."));
 		}
 
 		autogit_directory directory;
 		directory.set_path(path);
+		directory.relative_path = relative_to(options.path, directory.path.string());
+		directory.detection = options.detection;
+		directory.verify_days = options.verify_days;
+		directory.prune_days = options.prune_days;
+		for (auto& mirror : options.mirrors) {
+			auto root = mirror + mirror_key(directory);
+			if (this->mirror_used(root)) {
+				this->discovery_notes.push_back(qpl::to_string("paths.cfg : mirror ", root, " is already used by another directory, ", directory.path, " isn't mirrored there."));
+				continue;
+			}
+			directory.mirror_roots.push_back(root);
+		}
 		if (directory.empty()) {
 			if (path.is_directory() && !directory.is_solution_without_git()) {
 				auto list = path.list_current_directory();
 				for (auto& path : list) {
-					this->find_directory(path);
+					this->find_directory(path, options);
 				}
 			}
 		}
 		else {
 			this->directories.push_back(directory);
+			this->index.add(this->directories.size() - 1, directory.directory_name, directory.relative_path);
 		}
 	}
-	void print() {
+	void print() const {
 		qpl::size length = 0u;
 		for (auto& i : this->directories) {
 			if (!i.empty()) {
@@ -42,21 +102,135 @@ struct autogit {
 			}
 		}
 	}
-	void find_directories(const std::vector<std::string>& location) {
+	void find_directories(const std::vector<location_path>& location) {
 		this->directories.clear();
+		this->index.clear();
 		for (auto& i : location) {
-			this->find_directory(i);
+			this->find_directory(i.path, i);
 		}
 	}
+	//finds the directories in the background so the prompt shows right away. once done, the fetcher
+	//and the speculative status pass start. nothing is printed from the background.
+	void discover(std::vector<location_path> location) {
+		this->discovery = std::async(std::launch::async, [this, location = std::move(location)]() {
+			this->find_directories(location);
+			prefetch::background.start(this->git_paths());
+			speculation::background.start([this]() {
+				this->speculate();
+			});
+		}).share();
+	}
+	//the first wait after discovery prints what it found.
+	void wait_discovery() const {
+		if (this->discovery.valid()) {
+			this->discovery.get();
+			if (!this->discovery_shown.exchange(true)) {
+				events::flush();
+				for (auto& note : this->discovery_notes) {
+					qpl::println(note);
+				}
+				this->print();
+				qpl::println();
+			}
+		}
+	}
+	//precomputes the local part of a status, one directory at a time and only while the prompt is idle.
+	void speculate() {
+		for (auto& dir : this->directories) {
+			for (auto action : { action::push, action::pull }) {
+				while (speculation::background.running && !prefetch::idle) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+				if (!speculation::background.running) {
+					return;
+				}
+				std::lock_guard lock(speculation::mutex);
+				dir.speculate(action);
+			}
+		}
+	}
+	std::vector<std::string> git_paths() const {
+		std::vector<std::string> result;
+		for (auto& dir : this->directories) {
+			if (!dir.git_path.empty()) {
+				result.push_back(dir.git_path.string());
+			}
+		}
+		return result;
+	}
 
+	bool is_target(const autogit_directory& dir, const state& state) const {
+		return state.target_input_directories.empty() || (state.target_input_directories.size() && qpl::find(state.target_input_directories, dir.path));
+	}
+	//longest expected run first, directories without history count as the most expensive.
+	std::vector<autogit_directory*> scheduled_directories(const state& state) {
+		std::vector<std::pair<qpl::f64, autogit_directory*>> costs;
+		for (auto& dir : this->directories) {
+			if (this->is_target(dir, state)) {
+				auto cost = run_history::expected_cost(dir.path);
+				costs.push_back(std::make_pair(cost.value_or(std::numeric_limits<qpl::f64>::max()), &dir));
+			}
+		}
+		std::stable_sort(costs.begin(), costs.end(), [](auto a, auto b) {
+			return a.first > b.first;
+			});
+
+		std::vector<autogit_directory*> result;
+		for (auto& i : costs) {
+			result.push_back(i.second);
+		}
+		return result;
+	}
 	void execute_no_collisions(const state& state) {
+		if (state.concurrent) {
+			auto scheduled = this->scheduled_directories(state);
+			parallel_for(scheduled.size(), [&](qpl::size index) {
+				scheduled[index]->execute(state);
+			});
+			for (auto& dir : this->directories) {
+				if (this->is_target(dir, state)) {
+					dir.print_conflicts(state);
+				}
+			}
+			return;
+		}
 		for (auto& dir : this->directories) {
-			bool valid = state.target_input_directories.empty() || (state.target_input_directories.size() && qpl::find(state.target_input_directories, dir.path));
-			if (valid) {
+			if (this->is_target(dir, state)) {
 				dir.execute(state);
 			}
 		}
 	}
+	void record_runs() {
+		for (auto& dir : this->directories) {
+			dir.record_run();
+		}
+		run_history::save();
+	}
+	void print_history() {
+		std::vector<std::string> paths;
+		for (auto& dir : this->directories) {
+			paths.push_back(dir.path);
+		}
+		run_history::print_report(paths);
+	}
+	void manage_snapshots(const state& state) {
+		qpl::println();
+		for (auto& dir : this->directories) {
+			if (!dir.is_solution() || !this->is_target(dir, state)) {
+				continue;
+			}
+			if (state.restore) {
+				dir.restore_snapshot(state.restore_id);
+			}
+			if (state.snapshot_keep) {
+				auto removed = snapshot::prune(dir.snapshot_root(), state.snapshot_keep);
+				qpl::println(qpl::color::aqua, dir.path, " removed ", removed, " old snapshots.");
+			}
+			if (state.list_snapshots) {
+				dir.print_snapshots();
+			}
+		}
+	}
 	bool execute_check_collisions(const state& state) {
 		auto collision_state = state;
 
@@ -64,13 +238,38 @@ struct autogit {
 		collision_state.print = false;
 		collision_state.check_mode = true;
 		collision_state.only_conflicts = true;
+		collision_state.concurrent = true;
 
 		this->execute_no_collisions(collision_state);
 		return confirm_collisions(collision_state);
 	}
 
 	void execute(const state& state) {
+		throttle::foreground_waiting = true;
+		std::lock_guard speculation_lock(speculation::mutex);
+		throttle::foreground_waiting = false;
 		qpl::clock timer;
+		events::stream.set_mode(state.render);
+		spill::memory_limit = state.memory_limit;
+		throttle::interactive.set(static_cast<qpl::f64>(state.io_bytes_limit), static_cast<qpl::f64>(state.io_operations_limit));
+		chunked_copy::threshold = state.chunk_threshold.value_or(chunked_copy::default_threshold);
+		chunked_copy::threads = state.copy_threads ? state.copy_threads : chunked_copy::default_threads;
+		chunked_copy::verify = state.verify_copies;
+		//the background fetcher refetches on the schedule the last command asked for.
+		prefetch::background.window = state.fetch_window;
+		if (state.report) {
+			this->print_history();
+			qpl::println('\n');
+			return;
+		}
+		if (state.restore || state.list_snapshots || state.snapshot_keep) {
+			this->manage_snapshots(state);
+			qpl::println('\n');
+			return;
+		}
+		snapshot::current_id.clear();
+		auto allocations = alloc_stats::take_all();
+		comparison_cache::clear();
 
 		bool needs_check = state.action != action::both && !state.status && !state.update && !state.hard_pull;
 		if (needs_check) {
@@ -87,7 +286,8 @@ struct autogit {
 						++found_moves;
 					}
 				}
-				if (found_moves) {
+				//the update offer is a console prompt, json and quiet status runs only report.
+				if (found_moves && events::console()) {
 					bool update = false;
 					while (true) {
 
@@ -137,6 +337,19 @@ struct autogit {
 			}
 		}
 
+		events::flush();
+		this->record_runs();
+		//the caches are written once per command, not after every directory pass.
+		detection_cache::save();
+		summary_cache::save();
+		if (state.snapshot && !state.check_mode) {
+			for (auto& dir : this->directories) {
+				if (dir.is_solution() && this->is_target(dir, state)) {
+					snapshot::prune(dir.snapshot_root(), snapshot::default_keep);
+				}
+			}
+		}
+		speculation::background.wake();
 		if (timer.elapsed_f() > 10.0) {
 			qpl::println('\n');
 			auto str = qpl::to_string("time : ", timer.elapsed().string_short());
@@ -144,6 +357,14 @@ struct autogit {
 			qpl::println(str);
 			qpl::println_repeat("-", str.length());
 		}
+		if (alloc_stats::enabled) {
+			qpl::println('\n');
+			auto after = alloc_stats::take_all();
+			for (qpl::size i = 0u; i < after.size(); ++i) {
+				auto phase = static_cast<alloc_stats::phase>(i);
+				qpl::println(qpl::color::gray, qpl::str_lspaced(qpl::to_string(alloc_stats::phase_string(phase), " : "), 10), (after[i] - allocations[i]).string());
+			}
+		}
 		qpl::println('\n');
 	}
 };
\ No newline at end of file
@@ -6,6 +6,10 @@
 #include "exe.hpp"
 #include "git.hpp"
 #include "collisions.hpp"
+#include "events.hpp"
+#include "schedule.hpp"
+#include "speculation.hpp"
+#include "mirrors.hpp"
 
 
 struct autogit_directory {
@@ -13,12 +17,25 @@ struct autogit_directory {
 	qpl::filesys::path git_path;
 	qpl::filesys::path path;
 	std::string directory_name;
+	//path below the location root from paths.cfg, empty if the location itself is the directory.
+	std::string relative_path;
+	::detection detection = detection::full;
+	qpl::size verify_days = 0u;
+	qpl::size prune_days = 0u;
+	std::vector<std::string> mirror_roots;
+	std::vector<mirrors::result> mirror_results;
 	status push_status;
 	status pull_status;
 	history_status history;
 	bool pulled = false;
 	bool can_safely_push = false;
 	bool can_safely_pull = false;
+	qpl::f64 scan_seconds = 0.0;
+	qpl::f64 git_seconds = 0.0;
+	qpl::u64 scanned_bytes = 0u;
+	qpl::u64 scanned_files = 0u;
+	speculative_move speculative_push;
+	speculative_move speculative_pull;
 
 	bool is_git() const {
 		return this->solution_path.empty() && !this->git_path.empty();
@@ -29,7 +46,7 @@ struct autogit_directory {
 	bool is_solution_without_git() const {
 		return !this->solution_path.empty() && this->git_path.empty();
 	}
-	bool empty() {
+	bool empty() const {
 		return !this->is_git() && !this->is_solution();
 	}
 	void print() {
@@ -126,12 +143,111 @@ struct autogit_directory {
 			::exe(this->get_active_path(), state, this->history);
 		}
 	}
+	::detection get_detection(const state& state) const {
+		if (state.detection != detection::configured) {
+			return state.detection;
+		}
+		if (detection_cache::verification_due(this->path, this->verify_days)) {
+			return detection::full;
+		}
+		return this->detection;
+	}
+	speculative_move& speculative(action action) {
+		return action == action::push ? this->speculative_push : this->speculative_pull;
+	}
+	//the check-mode move a status would run, computed in the background with its events held back.
+	void speculate(action action) {
+		if (!this->is_solution()) {
+			return;
+		}
+		::state state;
+		state.status = true;
+		state.check_mode = true;
+		state.action = action;
+		state.detection = this->get_detection(state);
+
+		auto roots = move_roots(this->get_active_path(), action);
+		auto fingerprint = speculation::fingerprint(roots);
+		auto& cached = this->speculative(action);
+		if (cached.valid && cached.fingerprint == fingerprint && cached.detection == state.detection) {
+			return;
+		}
+
+		speculative_move result;
+		result.detection = state.detection;
+		result.fingerprint = fingerprint;
+		auto changes = info::total_change_sum.load();
+		events::capture = &result.events;
+		::move(this->get_active_path(), state, result.history);
+		events::capture = nullptr;
+		result.changes = info::total_change_sum - changes;
+		info::total_change_sum = changes;
+		result.valid = true;
+		cached = std::move(result);
+		detection_cache::save();
+		summary_cache::save();
+	}
+	bool reuse_speculation(const state& state) {
+		if (!state.check_mode || !state.find_collisions || state.streaming) {
+			return false;
+		}
+		auto& cached = this->speculative(state.action);
+		if (!cached.valid || cached.detection != state.detection) {
+			return false;
+		}
+		if (speculation::fingerprint(move_roots(this->get_active_path(), state.action)) != cached.fingerprint) {
+			cached.valid = false;
+			return false;
+		}
+		speculation::replay(cached, state, this->history);
+		return true;
+	}
 	void perform_move(state state) {
 		if (state.location != location::git) {
 			if (state.status) {
 				state.check_mode = true;
 			}
-			::move(this->get_active_path(), state, this->history);
+			state.detection = this->get_detection(state);
+			state.prune = this->prune_days && !summary_cache::full_walk_due(this->path, this->prune_days);
+			std::optional<mirrors::fanout> fanout;
+			directory_follower follow;
+			if (this->mirrors_due(state)) {
+				fanout.emplace(this->get_active_path().ensured_directory_backslash().string(), this->mirror_roots, state, this->history);
+				follow = [&](const std::string& directory, const std::vector<entry_stat>& entries) {
+					fanout->follow(directory, entries);
+				};
+			}
+			if (!this->reuse_speculation(state)) {
+				::move(this->get_active_path(), state, this->history, follow);
+			}
+			this->finish_mirrors(fanout);
+			this->scanned_bytes += this->history.scanned_bytes;
+			this->scanned_files += this->history.scanned_files;
+			run_history::record_pass(this->path, state.action == action::pull ? "pull" : "push", this->history.scanned_files, this->history.scanned_bytes);
+
+			//a partly applied move verified nothing and doesn't count as a full walk.
+			if (state.detection == detection::full && this->verify_days && !this->history.apply_failed) {
+				detection_cache::record_verification(this->path);
+			}
+			if (this->prune_days && !state.prune && !this->history.apply_failed) {
+				summary_cache::record_full_walk(this->path);
+			}
+		}
+	}
+	//backup mirrors follow the working directory on push, they are never pulled from.
+	bool mirrors_due(const state& state) const {
+		return state.action == action::push && !state.only_conflicts && !this->mirror_roots.empty() && this->is_solution();
+	}
+	void finish_mirrors(std::optional<mirrors::fanout>& fanout) {
+		this->mirror_results.clear();
+		if (!fanout.has_value()) {
+			return;
+		}
+		this->mirror_results = fanout->finish();
+		for (auto& result : this->mirror_results) {
+			if (!result.clean()) {
+				this->history.move_changes = true;
+			}
 		}
 	}
 	void perform_git(const state& state) {
@@ -158,13 +274,16 @@ struct autogit_directory {
 			if (!confirm_collisions(collision_state)) {
 				return;
 			}
-			if (info::total_change_sum && !collision_state.status) {
+			if (info::total_change_sum && !collision_state.status && events::console()) {
 				qpl::println("local pull test returned sucessfully.");
 			}
 		}
 
-		bool git_print = command == command::git;
-		bool move_print = command == command::move;
+		events::flush();
+		//the headers and verdicts are console decoration, quiet and json output only carry the events.
+		bool console = events::console();
+		bool git_print = command == command::git && console;
+		bool move_print = command == command::move && console;
 
 		auto word = state.action == action::pull ? "PULL" : "PUSH";
 		auto status_word = state.status ? "status" : "update status";
@@ -177,7 +296,15 @@ struct autogit_directory {
 			qpl::print(cw, "-----", " move [", cw, word, "] ", status_word, " ");
 		}
 
-		this->history.command_reset();
+		events::stream.command_reset();
+		auto allocations = alloc_stats::take();
+		qpl::clock timer;
+		alloc_stats::scope alloc_scope(command == command::git ? alloc_stats::phase::git : alloc_stats::phase::scan);
+		bool show_progress = command == command::move && !state.concurrent;
+		if (show_progress) {
+			auto [files, bytes] = run_history::expected_pass(this->path, state.action == action::pull ? "pull" : "push");
+			progress::begin(this->path, files, bytes);
+		}
 		switch (command) {
 		case command::move:
 			if (state.action == action::pull) {
@@ -193,7 +320,19 @@ struct autogit_directory {
 			this->perform_git(state);
 			break;
 		}
+		if (show_progress) {
+			progress::end();
+		}
+		auto seconds = timer.elapsed_f();
+		if (command == command::git) {
+			this->git_seconds += seconds;
+		}
+		else {
+			this->scan_seconds += seconds;
+		}
+		allocations = alloc_stats::take() - allocations;
 
+		events::flush();
 		if (!state.only_conflicts && git_print) {
 			auto word = state.action == action::pull ? "fetch" : "commit";
 			if (!this->history.git_changes) {
@@ -210,9 +349,13 @@ struct autogit_directory {
 			else if (state.update && this->history.move_changes && state.status) {
 				qpl::println(qpl::color::light_yellow, "directories are changed.");
 			}
+			mirrors::print(this->mirror_results);
+		}
+		if (alloc_stats::enabled && !state.only_conflicts && console) {
+			qpl::println(qpl::color::gray, allocations.string(), " in ", run_history::seconds_string(seconds));
 		}
 
-		if (this->history.any_output) {
+		if (console && events::stream.has_output()) {
 			qpl::println();
 		}
 	}
@@ -278,14 +421,61 @@ struct autogit_directory {
 		this->determine_status(state);
 
 		auto actual_update = !state.check_mode;
-		if (state.only_conflicts && this->history.any_collisions()) {
-			qpl::println("COLLISIONS ", qpl::color::aqua, this->path);
-			print_collisions(state, this->history);
+		if (state.only_conflicts && !state.concurrent) {
+			this->print_conflicts(state);
 		}
 		else if (state.print && !actual_update) {
 			print_collisions(state, this->history);
 		}
 	}
+	void print_conflicts(const state& state) {
+		if (this->history.any_collisions()) {
+			qpl::println("COLLISIONS ", qpl::color::aqua, this->path);
+			print_collisions(state, this->history);
+		}
+	}
+	std::filesystem::path snapshot_root() const {
+		return std::filesystem::path(this->get_active_path().get_parent_branch().string());
+	}
+	void print_snapshots() {
+		auto ids = snapshot::list(this->snapshot_root());
+		if (ids.empty()) {
+			qpl::println(qpl::color::aqua, this->path, qpl::color::gray, " no snapshots.");
+			return;
+		}
+		qpl::println(qpl::color::aqua, this->path);
+		for (auto& id : ids) {
+			qpl::println(". . . . ", id, qpl::color::gray, qpl::to_string(" (", snapshot::file_count(this->snapshot_root(), id), " files)"));
+		}
+	}
+	void restore_snapshot(const std::string& id) {
+		auto ids = snapshot::list(this->snapshot_root());
+		auto target = id.empty() ? (ids.empty() ? std::string{} : ids.back()) : id;
+		if (target.empty() || std::find(ids.cbegin(), ids.cend(), target) == ids.cend()) {
+			qpl::println(qpl::color::aqua, this->path, qpl::color::light_red, qpl::to_string(" no snapshot \"", target, "\"."));
+			return;
+		}
+		auto count = snapshot::restore(this->snapshot_root(), target);
+		events::flush();
+		qpl::println(qpl::color::aqua, this->path, " restored ", count, " files from ", qpl::color::aqua, target, '.');
+	}
+	void record_run() {
+		if (this->scan_seconds == 0.0 && this->git_seconds == 0.0) {
+			return;
+		}
+		run_record record;
+		record.time = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		record.scan_seconds = this->scan_seconds;
+		record.git_seconds = this->git_seconds;
+		record.bytes = this->scanned_bytes;
+		record.files = this->scanned_files;
+		run_history::add(this->path, record);
+
+		this->scan_seconds = 0.0;
+		this->git_seconds = 0.0;
+		this->scanned_bytes = 0u;
+		this->scanned_files = 0u;
+	}
 	void perform_safe_move(state state) {
 		if (!this->can_do_safe_move()) {
 			return;
@@ -295,7 +485,8 @@ struct autogit_directory {
 
 		auto can_push_both_changes = this->status_can_push_both_changes();
 		auto can_pull_both_changes = this->status_can_pull_both_changes();
-		if (can_push_both_changes || can_pull_both_changes) {
+		bool console = events::console();
+		if (console && (can_push_both_changes || can_pull_both_changes)) {
 			auto word = can_push_both_changes ? "push" : "pull";
 			qpl::print("overwriting the git directory changes after ", can_push_both_changes ? "local " : "git ", qpl::color::aqua, word);
 		}
@@ -304,14 +495,14 @@ struct autogit_directory {
 			state.action = action::push;
 			auto commands = this->get_commands(state);
 
-			qpl::println();
+			if (console) qpl::println();
 			this->execute(state, this->get_commands(state));
 		}
 		else if (this->status_can_pull() || can_pull_both_changes) {
 			state.action = action::pull;
 			auto commands = this->get_commands(state);
 
-			qpl::println();
+			if (console) qpl::println();
 			this->execute(state, this->get_commands(state));
 		}
 		this->status_reset();
@@ -332,12 +523,15 @@ struct autogit_directory {
 		}
 		this->status_reset();
 
-		if (state.action == action::both && (state.status || state.update)) {
+		//hard-pull is only honored in its own path below, behind the HARD-RESET prompt. "status hard-pull" goes
+		//there too, "update hard-pull" is an update: its push must not be followed by a reset of git/.
+		if (state.action == action::both && (state.update || (state.status && !state.hard_pull))) {
+			state.hard_pull = false;
 			if (this->get_pull_commands(state).empty() && this->get_push_commands(state).empty()) {
 				return;
 			}
 
-			if (!state.only_conflicts) {
+			if (!state.only_conflicts && events::console()) {
 				auto word = state.status ? "STATUS " : "UPDATE ";
 				qpl::println('\n', word, qpl::color::aqua, this->path);
 			}
@@ -379,23 +573,26 @@ struct autogit_directory {
 				this->can_safely_pull = can_pull || can_pull_both_changes;
 				this->can_safely_push = can_push || can_push_both_changes;
 
-				if (can_push || can_pull) {
-					auto word = can_push ? "push" : "pull";
-					if (!this->history.any_output) qpl::println();
-					qpl::println(".-----------------.");
-					qpl::println("| can safely ", qpl::color::aqua, word, " |");
-					qpl::println(".-----------------.");
-				}
-				if (can_push_both_changes || can_pull_both_changes) {
-					auto word = can_push_both_changes ? "push" : "pull";
-					if (!this->history.any_output) qpl::println();
+				//console only.
+				if (events::console()) {
+					if (can_push || can_pull) {
+						auto word = can_push ? "push" : "pull";
+						if (!events::stream.has_output()) qpl::println();
+						qpl::println(".-----------------.");
+						qpl::println("| can safely ", qpl::color::aqua, word, " |");
+						qpl::println(".-----------------.");
+					}
+					if (can_push_both_changes || can_pull_both_changes) {
+						auto word = can_push_both_changes ? "push" : "pull";
+						if (!events::stream.has_output()) qpl::println();
 
-					qpl::println(".---------------------------------------------------------.");
-					qpl::println("| can ", qpl::color::aqua, word, ", but would overwrite changes in the git folder | ");
-					qpl::println(".---------------------------------------------------------.");
-				}
-				else if (this->status_has_conflicts()) {
-					qpl::println(qpl::color::light_red, "CONFLICT summary: ", this->status_conflict_string());
+						qpl::println(".---------------------------------------------------------.");
+						qpl::println("| can ", qpl::color::aqua, word, ", but would overwrite changes in the git folder | ");
+						qpl::println(".---------------------------------------------------------.");
+					}
+					else if (this->status_has_conflicts()) {
+						qpl::println(qpl::color::light_red, "CONFLICT summary: ", this->status_conflict_string());
+					}
 				}
 			}
 
@@ -429,7 +626,7 @@ struct autogit_directory {
 			if (commands.empty()) {
 				return;
 			}
-			if (!state.only_conflicts) {
+			if (!state.only_conflicts && events::console()) {
 				auto word = state.status ? "STATUS " : "UPDATE ";
 				qpl::println('\n', word, qpl::color::aqua, this->path);
 			}
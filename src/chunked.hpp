@@ -0,0 +1,246 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "progress.hpp"
+
+#if defined(_WIN32)
+#include <qpl/winsys.hpp>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//copies of large files split into disjoint ranges that are copied concurrently. the destination is preallocated,
+//with "apply=verify" every chunk is hashed while it is copied, read back and compared against that hash.
+namespace chunked_copy {
+	constexpr qpl::size default_threshold = 256u << 20;
+	constexpr qpl::size chunk_size = 32u << 20;
+	constexpr qpl::size buffer_size = 1u << 20;
+	constexpr qpl::size default_threads = 4u;
+
+	//files of at least threshold bytes are chunked, 0 disables it. set per command from "chunk=" / "copythreads=" / "apply=verify".
+	std::atomic_size_t threshold = default_threshold;
+	std::atomic_size_t threads = default_threads;
+	std::atomic_bool verify = false;
+
+	bool eligible(qpl::u64 size) {
+		return threshold && size >= threshold;
+	}
+
+	struct file {
+#if defined(_WIN32)
+		//overlapped handles, a synchronous handle serializes every read and write of the workers.
+		HANDLE handle = INVALID_HANDLE_VALUE;
+
+		bool open_read(const std::string& path) {
+			this->handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+			return this->handle != INVALID_HANDLE_VALUE;
+		}
+		bool open_write(const std::string& path, qpl::u64 size) {
+			this->handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+			if (this->handle == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			FILE_ALLOCATION_INFO allocation;
+			allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+			SetFileInformationByHandle(this->handle, FileAllocationInfo, &allocation, sizeof(allocation));
+			FILE_END_OF_FILE_INFO end;
+			end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+			return SetFileInformationByHandle(this->handle, FileEndOfFileInfo, &end, sizeof(end)) != 0;
+		}
+		//one event per request, the caller waits for its own range only.
+		template<typename F>
+		qpl::i64 transfer(qpl::u64 offset, F&& start) {
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+			if (!overlapped.hEvent) {
+				return -1;
+			}
+			DWORD done = 0;
+			bool success = start(&overlapped) || GetLastError() == ERROR_IO_PENDING;
+			if (success) {
+				success = GetOverlappedResult(this->handle, &overlapped, &done, TRUE) != 0;
+			}
+			auto end_of_file = !success && GetLastError() == ERROR_HANDLE_EOF;
+			CloseHandle(overlapped.hEvent);
+			if (end_of_file) {
+				return 0;
+			}
+			return success ? qpl::i64{ done } : -1;
+		}
+		qpl::i64 read(char* data, qpl::size size, qpl::u64 offset) {
+			return this->transfer(offset, [&](OVERLAPPED* overlapped) {
+				return ReadFile(this->handle, data, static_cast<DWORD>(size), nullptr, overlapped) != 0;
+			});
+		}
+		qpl::i64 write(const char* data, qpl::size size, qpl::u64 offset) {
+			return this->transfer(offset, [&](OVERLAPPED* overlapped) {
+				return WriteFile(this->handle, data, static_cast<DWORD>(size), nullptr, overlapped) != 0;
+			});
+		}
+		void close() {
+			if (this->handle != INVALID_HANDLE_VALUE) {
+				CloseHandle(this->handle);
+				this->handle = INVALID_HANDLE_VALUE;
+			}
+		}
+#else
+		int fd = -1;
+
+		bool open_read(const std::string& path) {
+			this->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			return this->fd >= 0;
+		}
+		//posix_fallocate fails on file systems without preallocation, the size is then only reserved by ftruncate.
+		bool open_write(const std::string& path, qpl::u64 size) {
+			this->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (this->fd < 0) {
+				return false;
+			}
+			if (::posix_fallocate(this->fd, 0, static_cast<off_t>(size)) == 0) {
+				return true;
+			}
+			return ::ftruncate(this->fd, static_cast<off_t>(size)) == 0;
+		}
+		qpl::i64 read(char* data, qpl::size size, qpl::u64 offset) {
+			return ::pread(this->fd, data, size, static_cast<off_t>(offset));
+		}
+		qpl::i64 write(const char* data, qpl::size size, qpl::u64 offset) {
+			return ::pwrite(this->fd, data, size, static_cast<off_t>(offset));
+		}
+		void close() {
+			if (this->fd >= 0) {
+				::close(this->fd);
+				this->fd = -1;
+			}
+		}
+#endif
+		~file() {
+			this->close();
+		}
+	};
+
+	struct result {
+		bool success = false;
+		std::string error;
+	};
+
+	//hash of destination bytes [offset, offset + size), read back after the chunk was written.
+	std::optional<qpl::u64> read_hash(file& file, std::vector<char>& buffer, qpl::u64 offset, qpl::u64 size) {
+		auto hash = hash_seed;
+		while (size) {
+			auto take = static_cast<qpl::size>(qpl::min(size, qpl::u64{ buffer.size() }));
+			auto done = file.read(buffer.data(), take, offset);
+			if (done <= 0) {
+				return std::nullopt;
+			}
+			hash = hash_bytes(buffer.data(), static_cast<qpl::size>(done), hash);
+			offset += static_cast<qpl::u64>(done);
+			size -= static_cast<qpl::u64>(done);
+		}
+		return hash;
+	}
+
+	//copies size bytes of source into destination, a fresh file the caller owns, then applies the source's write
+	//time and permissions. a failed copy removes the partly written destination.
+	result copy(const std::string& source, const std::string& destination, qpl::u64 size) {
+		result result;
+		file input;
+		file output;
+		if (!input.open_read(source)) {
+			result.error = "couldn't open the source";
+			return result;
+		}
+		if (!output.open_write(destination, size)) {
+			result.error = "couldn't create or preallocate the destination";
+			output.close();
+			std::error_code error;
+			std::filesystem::remove(destination, error);
+			return result;
+		}
+
+		auto chunks = static_cast<qpl::size>((size + chunk_size - 1u) / chunk_size);
+		std::atomic_bool failed = false;
+		std::atomic_bool mismatch = false;
+		parallel_for(chunks, [&](qpl::size index) {
+			if (failed) {
+				return;
+			}
+			std::vector<char> buffer(buffer_size);
+			auto start = qpl::u64{ index } * chunk_size;
+			auto length = qpl::min(qpl::u64{ chunk_size }, size - start);
+			auto hash = hash_seed;
+			for (qpl::u64 offset = start; offset < start + length && !failed; ) {
+				auto take = static_cast<qpl::size>(qpl::min(qpl::u64{ buffer_size }, start + length - offset));
+				auto read = input.read(buffer.data(), take, offset);
+				if (read <= 0) {
+					failed = true;
+					return;
+				}
+				for (qpl::i64 written = 0; written < read; ) {
+					auto done = output.write(buffer.data() + written, static_cast<qpl::size>(read - written), offset + static_cast<qpl::u64>(written));
+					if (done <= 0) {
+						failed = true;
+						return;
+					}
+					written += done;
+				}
+				if (verify) {
+					hash = hash_bytes(buffer.data(), static_cast<qpl::size>(read), hash);
+				}
+				offset += static_cast<qpl::u64>(read);
+				progress::copied(static_cast<qpl::u64>(read));
+			}
+			if (verify && !failed) {
+				auto written = read_hash(output, buffer, start, length);
+				if (!written.has_value() || written.value() != hash) {
+					mismatch = true;
+					failed = true;
+				}
+			}
+		}, qpl::max(qpl::size{ 1u }, threads.load()));
+		input.close();
+		output.close();
+
+		std::error_code error;
+		if (failed) {
+			result.error = mismatch ? "a copied chunk doesn't match its source hash" : "reading or writing a chunk failed";
+			std::filesystem::remove(destination, error);
+			return result;
+		}
+		std::filesystem::last_write_time(destination, std::filesystem::last_write_time(source, error), error);
+		auto permissions = std::filesystem::status(source, error).permissions();
+		if (!error) {
+			std::filesystem::permissions(destination, permissions, error);
+		}
+		result.success = true;
+		return result;
+	}
+
+	//copy_overwrite for any size. large files are chunked into a temporary file next to the destination that is
+	//renamed over it once complete, so a failed copy leaves the previous destination untouched.
+	void copy_overwrite(const qpl::filesys::path& source, const qpl::filesys::path& destination, qpl::u64 size) {
+		if (!eligible(size)) {
+			source.copy_overwrite(destination);
+			progress::copied(size);
+			return;
+		}
+		auto temporary = destination.string() + ".autogit_partial";
+		auto result = copy(source.string(), temporary, size);
+		if (!result.success) {
+			events::error(qpl::to_string("COPY : ", source, " : ", result.error));
+			return;
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, destination.string(), error);
+		if (error) {
+			events::error(qpl::to_string("COPY : couldn't replace ", destination, " : ", error.message()));
+			std::filesystem::remove(temporary, error);
+		}
+	}
+}
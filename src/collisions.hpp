@@ -2,48 +2,52 @@
 
 #include "state.hpp"
 #include "info.hpp"
+#include "events.hpp"
 
 void print_collisions(const state& state, history_status& history) {
+	if (!events::console()) {
+		return;
+	}
 	auto action_word = state.action == action::pull ? "PULL" : "PUSH";
 	auto size = history.time_overwrites.size();
 
 	bool printed = false;
 	if (size) {
-		if (!history.any_output) qpl::println();
+		if (!events::stream.has_output()) qpl::println();
 		qpl::println("HINT: There ", (size == 1 ? "is " : "are "), size, (size == 1 ? " file " : " files "), "where a ", qpl::color::aqua, action_word, " would overwrite a more recent version, but the data is same.");
 
-		for (auto& i : history.time_overwrites) {
+		history.time_overwrites.for_each([](const std::string& i) {
 			qpl::println(qpl::color::light_aqua, ". . . . ", i);
-		}
-		history.any_output = true;
+		});
+		events::stream.mark_output();
 		printed = true;
 	}
 
 	size = history.data_overwrites.size();
 	if (size) {
-		if (printed || !history.any_output) qpl::println();
+		if (printed || !events::stream.has_output()) qpl::println();
 
 		if (!state.check_mode) {
 			qpl::print("WARNING: ");
 		}
 		qpl::println("There ", (size == 1 ? "is " : "are "), size, (size == 1 ? " file " : " files "), "where a ", qpl::color::light_red, action_word, " would overwrite a more recent version.");
-		for (auto& i : history.data_overwrites) {
+		history.data_overwrites.for_each([](const std::string& i) {
 			qpl::println(qpl::color::light_red, ". . . . ", i);
-		}
-		history.any_output = true;
+		});
+		events::stream.mark_output();
 		printed = true;
 	}
 	size = history.removes.size();
 	if (size) {
-		if (printed || !history.any_output) qpl::println();
+		if (printed || !events::stream.has_output()) qpl::println();
 		if (!state.check_mode) {
 			qpl::print("WARNING: ");
 		}
 		qpl::println("There ", (size == 1 ? "is " : "are "), size, (size == 1 ? " file " : " files "), "where a ", qpl::color::light_red, action_word, " would remove them.");
-		for (auto& i : history.removes) {
+		history.removes.for_each([](const std::string& i) {
 			qpl::println(qpl::color::light_red, ". . . . ", i);
-		}
-		history.any_output = true;
+		});
+		events::stream.mark_output();
 		printed = true;
 	}
 	if (printed) qpl::println();
@@ -51,10 +55,23 @@ void print_collisions(const state& state, history_status& history) {
 
 bool confirm_collisions(const state& state) {
 	if (info::total_change_sum && !state.status) {
+		events::flush();
+		if (state.snapshot) {
+			if (events::console()) {
+				qpl::println();
+				qpl::println("overwritten and removed files are kept in a snapshot, use ", qpl::color::aqua, "restore=last", " to undo.");
+			}
+			return true;
+		}
+		//print_collisions listed nothing outside of the console, overwriting unseen files is declined.
+		if (!events::console()) {
+			events::error(qpl::to_string("COLLISIONS : ", info::total_change_sum.load(), " files would be overwritten or removed, declined without the console. use \"apply=snapshot\" to apply them anyway."));
+			return false;
+		}
 		while (true) {
 			qpl::println();
 			auto word = info::total_change_sum > 1 ? "files" : "file";
-			qpl::print("are you SURE you want to overwrite ", qpl::color::light_red, info::total_change_sum, ' ', word, " ? (y / n) > ");
+			qpl::print("are you SURE you want to overwrite ", qpl::color::light_red, info::total_change_sum.load(), ' ', word, " ? (y / n) > ");
 
 			auto input = qpl::get_input();
 			if (qpl::string_equals_ignore_case(input, "y")) {
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <mutex>
+#include "detection.hpp"
+#include "walker.hpp"
+#include "progress.hpp"
+#include "git_index.hpp"
+
+//everything known about one source/destination pair. the stat part comes from the directory listings,
+//content and digests are only filled in once something actually read the files.
+struct file_comparison {
+	qpl::u64 source_size = 0u;
+	qpl::u64 destination_size = 0u;
+	std::filesystem::file_time_type source_time;
+	std::filesystem::file_time_type destination_time;
+	bool equals = false;
+	std::optional<bool> same_content;
+	std::optional<qpl::u64> source_hash;
+	std::optional<qpl::u64> destination_hash;
+
+	bool same_size() const {
+		return this->source_size == this->destination_size;
+	}
+	bool same_time() const {
+		return this->source_time == this->destination_time;
+	}
+	bool destination_newer() const {
+		return this->destination_time > this->source_time;
+	}
+	bool same_stat(const move_entry& entry) const {
+		return entry.destination_stat.has_value() &&
+			this->source_size == entry.source_stat.size && this->destination_size == entry.destination_stat->size &&
+			this->source_time == entry.source_stat.time && this->destination_time == entry.destination_stat->time;
+	}
+
+	//a side inside the git mirror whose blob id is still in .git/index lets only the other side be read. the index is
+	//only used where git converts nothing, so the blob id hashes the raw bytes and a differing id is a difference.
+	std::optional<bool> indexed_equal(const qpl::filesys::path& source, const qpl::filesys::path& destination, const git_index::index* index) const {
+		if (!index) {
+			return std::nullopt;
+		}
+		auto other = source.string();
+		auto blob = git_index::indexed_blob(*index, destination.string(), this->destination_size, this->destination_time);
+		if (!blob.has_value()) {
+			other = destination.string();
+			blob = git_index::indexed_blob(*index, source.string(), this->source_size, this->source_time);
+		}
+		if (!blob.has_value()) {
+			return std::nullopt;
+		}
+		throttle::io(this->source_size);
+		auto read = git_blob_id(other);
+		progress::compared(this->source_size);
+		return read.has_value() && read.value() == blob.value();
+	}
+
+	//reads the pair at most once, digests that are already known answer it without reading.
+	//index is the git mirror's index loaded for the running move, if any.
+	bool content(const qpl::filesys::path& source, const qpl::filesys::path& destination, const git_index::index* index = nullptr) {
+		if (!this->same_content.has_value()) {
+			if (this->source_hash.has_value() && this->destination_hash.has_value()) {
+				this->same_content = this->source_hash.value() == this->destination_hash.value();
+			}
+			else if (this->source_size != this->destination_size) {
+				this->same_content = false;
+			}
+			else if (auto indexed = this->indexed_equal(source, destination, index)) {
+				this->same_content = indexed.value();
+			}
+			else {
+				throttle::io(this->source_size + this->destination_size);
+				this->same_content = content_equals(source, destination);
+				progress::compared(this->source_size + this->destination_size);
+			}
+		}
+		return this->same_content.value();
+	}
+};
+
+//comparisons that read content, kept for the rest of the command so the apply pass after the
+//collision check doesn't read the same files again. an entry is only used while both stats are unchanged.
+namespace comparison_cache {
+	std::mutex mutex;
+	std::unordered_map<std::string, file_comparison> entries;
+
+	std::optional<file_comparison> find(const std::string& destination, const move_entry& entry) {
+		std::lock_guard lock(mutex);
+		auto it = entries.find(destination);
+		if (it == entries.cend() || !it->second.same_stat(entry)) {
+			return std::nullopt;
+		}
+		return it->second;
+	}
+	void store(const std::string& destination, const file_comparison& comparison) {
+		if (!comparison.same_content.has_value()) {
+			return;
+		}
+		std::lock_guard lock(mutex);
+		entries[destination] = comparison;
+	}
+	void clear() {
+		std::lock_guard lock(mutex);
+		entries.clear();
+	}
+}
+
+//equals is true if the destination doesn't need to be touched. every level agrees that a different size is a change,
+//all but full also treat a different mtime as one.
+//index is the git mirror's index, its clean tracked files are answered from it once content has to be read.
+file_comparison compare_files(const move_entry& entry, detection policy, const git_index::index* index = nullptr) {
+	auto cached = comparison_cache::find(entry.destination.string(), entry);
+	if (cached.has_value()) {
+		return cached.value();
+	}
+
+	file_comparison result;
+	result.source_size = entry.source_stat.size;
+	result.destination_size = entry.destination_stat->size;
+	result.source_time = entry.source_stat.time;
+	result.destination_time = entry.destination_stat->time;
+
+	auto& source = entry.source;
+	auto& destination = entry.destination;
+	if (!result.same_size()) {
+		result.same_content = false;
+		return result;
+	}
+	if (policy == detection::full || policy == detection::configured) {
+		result.equals = result.content(source, destination, index);
+		return result;
+	}
+	if (!result.same_time()) {
+		return result;
+	}
+	if (policy == detection::stat) {
+		result.equals = true;
+		return result;
+	}
+
+	auto identity1 = get_file_identity(source);
+	auto identity2 = get_file_identity(destination);
+
+	if (policy == detection::stat_inode) {
+		if (detection_cache::unchanged(source, identity1) && detection_cache::unchanged(destination, identity2)) {
+			result.equals = true;
+			result.same_content = true;
+			return result;
+		}
+		result.equals = result.content(source, destination, index);
+		if (result.equals) {
+			detection_cache::record(source, identity1);
+			detection_cache::record(destination, identity2);
+		}
+		return result;
+	}
+
+	result.source_hash = detection_cache::hash(source, identity1);
+	result.destination_hash = detection_cache::hash(destination, identity2);
+	result.equals = result.source_hash.has_value() && result.destination_hash.has_value() && result.content(source, destination, index);
+	return result;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <fstream>
+#include <mutex>
+
+//small key -> fields store, one tab separated line per key, kept next to the executable in "autogit_data/".
+struct local_database {
+	std::string name;
+	std::unordered_map<std::string, std::vector<std::string>> entries;
+	std::mutex mutex;
+	bool loaded = false;
+	bool changed = false;
+
+	local_database(std::string name) : name(std::move(name)) {
+
+	}
+
+	static std::filesystem::path directory() {
+		return std::filesystem::path(qpl::filesys::get_current_location().string()) / "autogit_data";
+	}
+	std::filesystem::path file_path() const {
+		return directory() / (this->name + ".db");
+	}
+
+	void load() {
+		if (this->loaded) {
+			return;
+		}
+		this->loaded = true;
+
+		std::ifstream file(this->file_path());
+		std::string line;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			std::vector<std::string> fields;
+			std::istringstream stream(line);
+			std::string field;
+			while (std::getline(stream, field, '\t')) {
+				fields.push_back(field);
+			}
+			if (fields.empty()) {
+				continue;
+			}
+			auto key = fields.front();
+			fields.erase(fields.begin());
+			this->entries[key] = std::move(fields);
+		}
+	}
+	void save() {
+		std::lock_guard lock(this->mutex);
+		if (!this->changed) {
+			return;
+		}
+		std::error_code error;
+		std::filesystem::create_directories(directory(), error);
+
+		auto temp = this->file_path();
+		temp += ".tmp";
+		{
+			std::ofstream file(temp, std::ios::trunc);
+			for (auto& [key, fields] : this->entries) {
+				file << key;
+				for (auto& field : fields) {
+					file << '\t' << field;
+				}
+				file << '\n';
+			}
+		}
+		std::filesystem::rename(temp, this->file_path(), error);
+		this->changed = false;
+	}
+
+	std::optional<std::vector<std::string>> find(const std::string& key) {
+		std::lock_guard lock(this->mutex);
+		this->load();
+		auto it = this->entries.find(key);
+		if (it == this->entries.cend()) {
+			return std::nullopt;
+		}
+		return it->second;
+	}
+	void set(const std::string& key, std::vector<std::string> fields) {
+		std::lock_guard lock(this->mutex);
+		this->load();
+		this->entries[key] = std::move(fields);
+		this->changed = true;
+	}
+	void remove(const std::string& key) {
+		std::lock_guard lock(this->mutex);
+		this->load();
+		this->changed = this->entries.erase(key) || this->changed;
+	}
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include "state.hpp"
+#include "database.hpp"
+#include "hash.hpp"
+#include "fingerprint.hpp"
+#include "throttle.hpp"
+
+#if defined(_WIN32)
+#include <qpl/winsys.hpp>
+#else
+#include <sys/stat.h>
+#endif
+
+struct location_path {
+	std::string path;
+	::detection detection = detection::full;
+	qpl::size verify_days = 0u;
+	qpl::size prune_days = 0u;
+	std::vector<std::string> mirrors;
+};
+
+std::optional<detection> detection_from_string(const std::string& string) {
+	if (qpl::string_equals_ignore_case(string, "stat") || qpl::string_equals_ignore_case(string, "quick")) {
+		return detection::stat;
+	}
+	else if (qpl::string_equals_ignore_case(string, "inode")) {
+		return detection::stat_inode;
+	}
+	else if (qpl::string_equals_ignore_case(string, "hash")) {
+		return detection::cached_hash;
+	}
+	else if (qpl::string_equals_ignore_case(string, "full")) {
+		return detection::full;
+	}
+	return std::nullopt;
+}
+
+//options split at whitespace outside of double quotes, the quotes themselves are dropped.
+std::vector<std::string> split_location_options(const std::string& options) {
+	std::vector<std::string> result;
+	std::string word;
+	bool quoted = false;
+	for (auto c : options) {
+		if (c == '"') {
+			quoted = !quoted;
+		}
+		else if (!quoted && qpl::is_character_whitespace(c)) {
+			if (!word.empty()) {
+				result.push_back(word);
+				word.clear();
+			}
+		}
+		else {
+			word.push_back(c);
+		}
+	}
+	if (!word.empty()) {
+		result.push_back(word);
+	}
+	return result;
+}
+
+//"detect=<stat|inode|hash|full> verify=<days> prune=<days> mirror=<path>", used after a location name or a path in paths.cfg.
+//a mirror path with spaces is quoted, mirror="D:/my backups/".
+void apply_location_options(location_path& location, const std::string& options) {
+	for (auto& word : split_location_options(options)) {
+		auto equals = word.find('=');
+		if (equals == std::string::npos) {
+			continue;
+		}
+		auto key = word.substr(0u, equals);
+		auto value = word.substr(equals + 1);
+		if (qpl::string_equals_ignore_case(key, "detect")) {
+			auto detection = detection_from_string(value);
+			if (detection.has_value()) {
+				location.detection = detection.value();
+			}
+			else {
+				qpl::println("paths.cfg : unknown detection \"", value, "\".");
+			}
+		}
+		else if (qpl::string_equals_ignore_case(key, "verify") && qpl::is_string_number(value)) {
+			location.verify_days = qpl::size_cast(value);
+		}
+		else if (qpl::string_equals_ignore_case(key, "prune") && qpl::is_string_number(value)) {
+			location.prune_days = qpl::size_cast(value);
+		}
+		else if (qpl::string_equals_ignore_case(key, "mirror") && !value.empty()) {
+			auto path = value;
+			std::replace(path.begin(), path.end(), '\\', '/');
+			if (path.back() != '/') {
+				path.push_back('/');
+			}
+			location.mirrors.push_back(path);
+		}
+	}
+}
+
+struct file_identity {
+	qpl::u64 size = 0u;
+	qpl::i64 mtime = 0;
+	qpl::u64 inode = 0u;
+	qpl::i64 ctime = 0;
+	bool valid = false;
+
+	bool operator==(const file_identity& other) const {
+		return this->valid && other.valid && this->size == other.size && this->mtime == other.mtime && this->inode == other.inode && this->ctime == other.ctime;
+	}
+	std::vector<std::string> fields() const {
+		return { std::to_string(this->size), std::to_string(this->mtime), std::to_string(this->inode), std::to_string(this->ctime) };
+	}
+	static file_identity from_fields(const std::vector<std::string>& fields) {
+		file_identity identity;
+		if (fields.size() < 4u) {
+			return identity;
+		}
+		try {
+			identity.size = std::stoull(fields[0]);
+			identity.mtime = std::stoll(fields[1]);
+			identity.inode = std::stoull(fields[2]);
+			identity.ctime = std::stoll(fields[3]);
+			identity.valid = true;
+		}
+		catch (...) {
+			identity.valid = false;
+		}
+		return identity;
+	}
+};
+
+file_identity get_file_identity(const std::string& path) {
+	file_identity identity;
+#if defined(_WIN32)
+	auto handle = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return identity;
+	}
+	BY_HANDLE_FILE_INFORMATION info;
+	FILE_BASIC_INFO basic;
+	if (GetFileInformationByHandle(handle, &info) && GetFileInformationByHandleEx(handle, FileBasicInfo, &basic, sizeof(basic))) {
+		identity.size = (qpl::u64{ info.nFileSizeHigh } << 32) | info.nFileSizeLow;
+		identity.mtime = basic.LastWriteTime.QuadPart;
+		identity.inode = (qpl::u64{ info.nFileIndexHigh } << 32) | info.nFileIndexLow;
+		identity.ctime = basic.ChangeTime.QuadPart;
+		identity.valid = true;
+	}
+	CloseHandle(handle);
+#else
+	struct stat info;
+	if (::stat(path.c_str(), &info) == 0) {
+		identity.size = static_cast<qpl::u64>(info.st_size);
+		identity.mtime = qpl::i64{ info.st_mtim.tv_sec } * 1'000'000'000 + info.st_mtim.tv_nsec;
+		identity.inode = static_cast<qpl::u64>(info.st_ino);
+		identity.ctime = qpl::i64{ info.st_ctim.tv_sec } * 1'000'000'000 + info.st_ctim.tv_nsec;
+		identity.valid = true;
+	}
+#endif
+	return identity;
+}
+
+namespace detection_cache {
+	//path -> size, mtime, inode, ctime [, hash] of the last verified state.
+	local_database files("detection");
+	//directory -> unix seconds of the last full content verification.
+	local_database verifications("verification");
+
+	bool unchanged(const std::string& path, const file_identity& identity) {
+		auto fields = files.find(path);
+		return fields.has_value() && file_identity::from_fields(fields.value()) == identity;
+	}
+	void record(const std::string& path, const file_identity& identity, std::optional<qpl::u64> hash = std::nullopt) {
+		if (!identity.valid) {
+			return;
+		}
+		auto fields = identity.fields();
+		if (hash.has_value()) {
+			fields.push_back(std::to_string(hash.value()));
+		}
+		files.set(path, fields);
+	}
+	std::optional<qpl::u64> hash(const std::string& path, const file_identity& identity) {
+		auto fields = files.find(path);
+		if (fields.has_value() && fields->size() > 4u && file_identity::from_fields(fields.value()) == identity) {
+			try {
+				return std::stoull(fields->at(4u));
+			}
+			catch (...) {
+			}
+		}
+		throttle::io(identity.size);
+		auto hash = file_hash(path);
+		if (hash.has_value()) {
+			record(path, identity, hash);
+		}
+		return hash;
+	}
+
+	qpl::i64 now_seconds() {
+		return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+	bool verification_due(const std::string& path, qpl::size verify_days) {
+		if (!verify_days) {
+			return false;
+		}
+		auto fields = verifications.find(path);
+		if (!fields.has_value() || fields->empty()) {
+			return true;
+		}
+		try {
+			auto last = std::stoll(fields->front());
+			return now_seconds() - last >= qpl::i64(verify_days) * 24 * 60 * 60;
+		}
+		catch (...) {
+			return true;
+		}
+	}
+	void record_verification(const std::string& path) {
+		verifications.set(path, { std::to_string(now_seconds()) });
+	}
+	void save() {
+		files.save();
+		verifications.save();
+	}
+}
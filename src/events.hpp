@@ -0,0 +1,394 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "state.hpp"
+#include "info.hpp"
+
+std::string time_diff_string(std::filesystem::file_time_type time1, std::filesystem::file_time_type time2, bool show_time_stamp) {
+
+	auto ns1 = std::chrono::duration_cast<std::chrono::nanoseconds>(time1.time_since_epoch()).count();
+	auto ns2 = std::chrono::duration_cast<std::chrono::nanoseconds>(time2.time_since_epoch()).count();
+
+	bool negative = ns2 < ns1;
+	if (negative) {
+		std::swap(ns1, ns2);
+		std::swap(time1, time2);
+	}
+
+	auto diff = qpl::time(ns2 - ns1).string_short("");
+	auto time_stamp = qpl::get_time_string(time2, "%Y-%m-%d %H-%M-%S");
+	auto diff_str = qpl::to_string("( ", negative ? '-' : '+', ' ', diff, " )");
+	if (show_time_stamp) {
+		return qpl::to_string(time_stamp, ' ', diff_str);
+	}
+	else {
+		return diff_str;
+	}
+}
+
+enum class event_type {
+	ignored,
+	new_directory,
+	added,
+	modified,
+	modified_time,
+	modified_bytes,
+	modified_metadata,
+	removed,
+	exe_added,
+	exe_modified,
+	time_overwrite,
+	data_overwrite,
+	remove_collision,
+	git_result,
+	error
+};
+
+constexpr auto event_type_string(event_type type) {
+	switch (type) {
+	case event_type::ignored: return "ignored";
+	case event_type::new_directory: return "new_directory";
+	case event_type::added: return "added";
+	case event_type::modified: return "modified";
+	case event_type::modified_time: return "modified_time";
+	case event_type::modified_bytes: return "modified_bytes";
+	case event_type::modified_metadata: return "modified_metadata";
+	case event_type::removed: return "removed";
+	case event_type::exe_added: return "exe_added";
+	case event_type::exe_modified: return "exe_modified";
+	case event_type::time_overwrite: return "time_overwrite";
+	case event_type::data_overwrite: return "data_overwrite";
+	case event_type::remove_collision: return "remove_collision";
+	case event_type::git_result: return "git_result";
+	case event_type::error: return "error";
+	}
+	return "";
+}
+
+struct event {
+	event_type type = event_type::error;
+	bool check_mode = false;
+	bool changes = false;
+	std::string path;
+	std::string message;
+	qpl::isize size = 0;
+	qpl::size count = 0u;
+	std::filesystem::file_time_type time1;
+	std::filesystem::file_time_type time2;
+};
+
+event make_event(event_type type, bool check_mode, std::string path) {
+	event event;
+	event.type = type;
+	event.check_mode = check_mode;
+	event.path = std::move(path);
+	return event;
+}
+
+//multiple producers push without locking, a single consumer drains (intrusive MPSC list).
+template<typename T>
+struct mpsc_queue {
+	struct node {
+		T value;
+		std::atomic<node*> next = nullptr;
+	};
+	std::atomic<node*> head;
+	node* tail;
+
+	mpsc_queue() {
+		auto stub = new node;
+		this->head.store(stub);
+		this->tail = stub;
+	}
+	~mpsc_queue() {
+		while (this->pop().has_value()) {
+		}
+		delete this->tail;
+	}
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	void push(T value) {
+		auto n = new node;
+		n->value = std::move(value);
+		auto previous = this->head.exchange(n, std::memory_order_acq_rel);
+		previous->next.store(n, std::memory_order_release);
+	}
+	std::optional<T> pop() {
+		auto next = this->tail->next.load(std::memory_order_acquire);
+		if (!next) {
+			return std::nullopt;
+		}
+		auto old = this->tail;
+		this->tail = next;
+		std::optional<T> result = std::move(next->value);
+		delete old;
+		return result;
+	}
+};
+
+std::string json_escape(const std::string& string) {
+	std::string result;
+	result.reserve(string.length());
+	for (auto c : string) {
+		switch (c) {
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default: result += c;
+		}
+	}
+	return result;
+}
+
+struct event_stream {
+	mpsc_queue<event> queue;
+	std::mutex consumer_mutex;
+	std::atomic_bool running = false;
+	std::thread render_thread;
+	std::atomic<::render_mode> mode = render_mode::console;
+	std::atomic_bool any_output = false;
+	//the progress line currently on screen, guarded by consumer_mutex.
+	std::string status_line;
+
+	~event_stream() {
+		this->stop();
+	}
+
+	void emit(event event) {
+		this->queue.push(std::move(event));
+	}
+
+	void render_console(const event& event) {
+		if (event.type == event_type::time_overwrite || event.type == event_type::data_overwrite || event.type == event_type::remove_collision) {
+			//shown in the collision summary
+			return;
+		}
+		if (event.type == event_type::git_result) {
+			if (!event.message.empty()) {
+				qpl::println();
+				qpl::println(event.message);
+			}
+			return;
+		}
+		if (event.type == event_type::error) {
+			qpl::println(event.message);
+			return;
+		}
+
+		if (!this->any_output) qpl::println();
+		this->any_output = true;
+
+		auto color = event.check_mode ? qpl::color::white : qpl::color::light_green;
+		switch (event.type) {
+		case event_type::ignored: {
+			auto word = event.check_mode ? "[*]IGNORED " : "IGNORED ";
+			qpl::println(qpl::str_lspaced(word, info::print_space), event.path);
+		} break;
+		case event_type::new_directory: {
+			auto word = event.check_mode ? "[*]NEW   " : "NEW DIR";
+			auto str = qpl::str_lspaced(qpl::to_string(word, " + ", qpl::memory_size_string(event.size)), info::print_space);
+			qpl::println(color, str, event.path);
+		} break;
+		case event_type::added: {
+			auto word = event.check_mode ? "[*]NEW   " : "ADDED  ";
+			auto str = qpl::str_lspaced(qpl::to_string(word, " + ", qpl::memory_size_string(event.size)), info::print_space);
+			qpl::println(color, str, event.path);
+		} break;
+		case event_type::modified: {
+			auto word = event.check_mode ? "[*]MODIFY" : "MODIFIED";
+			auto str = qpl::str_lspaced(qpl::to_string(word, event.size > 0 ? " + " : " - ", qpl::memory_size_string(qpl::abs(event.size))), info::print_space);
+			qpl::println(color, str, event.path);
+		} break;
+		case event_type::modified_time: {
+			auto word = event.check_mode ? "[*]MODIFY TIME" : "MODIFIED TIME";
+			auto str = qpl::to_string(word, ' ', time_diff_string(event.time1, event.time2, false));
+			qpl::println(color, qpl::str_lspaced(str, info::print_space), event.path);
+		} break;
+		case event_type::modified_bytes: {
+			auto word = event.check_mode ? "[*]MODIFY [BYTES CHANGED] " : "MODIFIED [BYTES CHANGED] ";
+			qpl::println(color, qpl::str_lspaced(word, info::print_space), event.path);
+		} break;
+		case event_type::modified_metadata: {
+			auto word = event.check_mode ? "[*]SYNC TIME" : "SYNCED TIME";
+			auto str = qpl::to_string(word, ' ', time_diff_string(event.time1, event.time2, false));
+			qpl::println(qpl::color::gray, qpl::str_lspaced(str, info::print_space), event.path);
+		} break;
+		case event_type::removed: {
+			auto word = event.check_mode ? "[*]REMOVE" : "REMOVED";
+			auto size = qpl::memory_size_string(event.size);
+			auto str = qpl::str_lspaced(event.count > 1 ? qpl::to_string(word, " - ", size, " (", event.count, ')') : qpl::to_string(word, " - ", size), info::print_space);
+			qpl::println(event.check_mode ? qpl::color::white : qpl::color::light_red, str, event.path);
+		} break;
+		case event_type::exe_added: {
+			auto word = event.check_mode ? "[*]NEW .exe" : "ADDED .exe";
+			qpl::println(color, qpl::str_lspaced(word, info::print_space), event.path);
+		} break;
+		case event_type::exe_modified: {
+			auto word = event.check_mode ? "[*]MODIFY .exe" : "MODIFIED .exe";
+			qpl::println(color, qpl::str_lspaced(word, info::print_space), event.path);
+		} break;
+		default:
+			break;
+		}
+	}
+	void render_json(const event& event) {
+		std::ostringstream stream;
+		stream << "{\"event\":\"" << event_type_string(event.type) << "\",\"check\":" << (event.check_mode ? "true" : "false");
+		if (!event.path.empty()) {
+			stream << ",\"path\":\"" << json_escape(event.path) << '"';
+		}
+		switch (event.type) {
+		case event_type::new_directory:
+		case event_type::added:
+		case event_type::modified:
+			stream << ",\"size\":" << event.size;
+			break;
+		case event_type::removed:
+			stream << ",\"size\":" << event.size << ",\"entries\":" << event.count;
+			break;
+		case event_type::modified_time:
+		case event_type::modified_metadata:
+		case event_type::time_overwrite:
+		case event_type::data_overwrite:
+			stream << ",\"time\":\"" << json_escape(time_diff_string(event.time1, event.time2, true)) << '"';
+			break;
+		case event_type::git_result:
+			stream << ",\"changes\":" << (event.changes ? "true" : "false");
+			break;
+		default:
+			break;
+		}
+		if (!event.message.empty()) {
+			stream << ",\"message\":\"" << json_escape(event.message) << '"';
+		}
+		stream << '}';
+		qpl::println(stream.str());
+	}
+	void render(const event& event) {
+		switch (this->mode) {
+		case render_mode::console:
+			this->render_console(event);
+			break;
+		case render_mode::quiet:
+			if (event.type == event_type::error) {
+				qpl::println(event.message);
+			}
+			break;
+		case render_mode::json:
+			this->render_json(event);
+			break;
+		}
+	}
+
+	//caller holds consumer_mutex.
+	void erase_status() {
+		if (!this->status_line.empty()) {
+			qpl::print('\r', std::string(this->status_line.length(), ' '), '\r');
+			this->status_line.clear();
+		}
+	}
+	void drain(bool erase) {
+		std::lock_guard lock(this->consumer_mutex);
+		if (erase) {
+			this->erase_status();
+		}
+		while (auto event = this->queue.pop()) {
+			this->erase_status();
+			this->render(event.value());
+		}
+	}
+	//the line goes below whatever was printed last and is redrawn in place until the next output.
+	void show_status(const std::string& line, const std::atomic_bool& visible) {
+		std::lock_guard lock(this->consumer_mutex);
+		if (!visible) {
+			return;
+		}
+		if (this->status_line.empty()) {
+			if (!this->any_output) {
+				qpl::println();
+			}
+			qpl::println();
+			this->any_output = true;
+		}
+		auto padding = this->status_line.length() > line.length() ? this->status_line.length() - line.length() : 0u;
+		qpl::print('\r', qpl::color::gray, line, std::string(padding, ' '));
+		this->status_line = line;
+	}
+	void clear_status() {
+		std::lock_guard lock(this->consumer_mutex);
+		this->erase_status();
+	}
+	//renders everything queued so far and removes the progress line, direct console output has to call this first.
+	void flush() {
+		this->drain(true);
+	}
+	void start() {
+		if (this->running) {
+			return;
+		}
+		this->running = true;
+		this->render_thread = std::thread([&]() {
+			while (this->running) {
+				this->drain(false);
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		});
+	}
+	void stop() {
+		if (!this->running) {
+			return;
+		}
+		this->running = false;
+		this->render_thread.join();
+		this->flush();
+	}
+
+	void set_mode(::render_mode mode) {
+		this->flush();
+		this->mode = mode;
+	}
+	void command_reset() {
+		this->flush();
+		this->any_output = false;
+	}
+	bool has_output() {
+		this->flush();
+		return this->any_output;
+	}
+	void mark_output() {
+		this->flush();
+		this->any_output = true;
+	}
+};
+
+namespace events {
+	event_stream stream;
+	//when set, events of this thread are collected here instead of being rendered.
+	thread_local std::vector<event>* capture = nullptr;
+
+	void emit(event event) {
+		if (capture) {
+			capture->push_back(std::move(event));
+			return;
+		}
+		stream.emit(std::move(event));
+	}
+	void flush() {
+		stream.flush();
+	}
+	bool console() {
+		return stream.mode == render_mode::console;
+	}
+	void error(std::string message) {
+		event event;
+		event.type = event_type::error;
+		event.message = std::move(message);
+		emit(std::move(event));
+	}
+}
@@ -2,6 +2,9 @@
 
 #include <qpl/qpl.hpp>
 #include "info.hpp"
+#include "events.hpp"
+#include "throttle.hpp"
+#include "chunked.hpp"
 
 std::optional<qpl::filesys::path> get_most_recent_exe(const qpl::filesys::path& path) {
 	auto parent = path.get_parent_branch();
@@ -58,20 +61,13 @@ void exe(const qpl::filesys::path& path, const state& state, history_status& his
 
 	history.move_changes = true;
 	if (state.print) {
-		if (!history.any_output) qpl::println();
-
-		std::string word;
-		if (destination.exists()) {
-			word = state.check_mode ? "[*]MODIFY .exe" : "MODIFIED .exe";
-		}
-		else {
-			word = state.check_mode ? "[*]NEW .exe" : "ADDED .exe";
-		}
-		qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, qpl::str_lspaced(word, info::print_space), destination);
-		history.any_output = true;
+		auto type = destination.exists() ? event_type::exe_modified : event_type::exe_added;
+		events::emit(make_event(type, state.check_mode, destination));
 	}
 
 	if (!state.check_mode) {
-		target_exe.copy_overwrite(destination);
+		auto size = target_exe.file_size();
+		throttle::io(size);
+		chunked_copy::copy_overwrite(target_exe, destination, size);
 	}
 }
\ No newline at end of file
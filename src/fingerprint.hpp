@@ -0,0 +1,68 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <fstream>
+#include "hash.hpp"
+
+constexpr qpl::size fingerprint_min_size = 16u << 20;
+constexpr qpl::size fingerprint_block_size = 1u << 14;
+constexpr qpl::size fingerprint_interior_blocks = 6u;
+
+//head, tail and evenly strided interior blocks. deterministic for a given size so both sides sample the same ranges.
+std::vector<qpl::u64> fingerprint_offsets(qpl::u64 size) {
+	std::vector<qpl::u64> offsets;
+	if (size <= fingerprint_block_size) {
+		offsets.push_back(0u);
+		return offsets;
+	}
+	auto last = size - fingerprint_block_size;
+	offsets.push_back(0u);
+	for (qpl::size i = 1u; i <= fingerprint_interior_blocks; ++i) {
+		auto offset = last * i / (fingerprint_interior_blocks + 1);
+		offsets.push_back(offset - offset % fingerprint_block_size);
+	}
+	offsets.push_back(last);
+	return offsets;
+}
+
+std::optional<qpl::u64> sampled_fingerprint(const std::string& path, qpl::u64 size) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return std::nullopt;
+	}
+	std::vector<char> buffer(fingerprint_block_size);
+	auto hash = hash_mix(size);
+	for (auto& offset : fingerprint_offsets(size)) {
+		file.seekg(static_cast<std::streamoff>(offset));
+		file.read(buffer.data(), buffer.size());
+		auto read = static_cast<qpl::size>(file.gcount());
+		if (!file && !file.eof()) {
+			return std::nullopt;
+		}
+		file.clear();
+		hash = hash_bytes(buffer.data(), read, hash ^ offset);
+	}
+	return hash;
+}
+
+//true only if the files are certainly different. false means "unknown", a full compare is still needed.
+bool definitely_different(const qpl::filesys::path& source, const qpl::filesys::path& destination) {
+	auto size1 = source.file_size();
+	auto size2 = destination.file_size();
+	if (size1 != size2) {
+		return true;
+	}
+	if (size1 < fingerprint_min_size) {
+		return false;
+	}
+	auto fingerprint1 = sampled_fingerprint(source, size1);
+	auto fingerprint2 = sampled_fingerprint(destination, size2);
+	return fingerprint1.has_value() && fingerprint2.has_value() && fingerprint1.value() != fingerprint2.value();
+}
+
+bool content_equals(const qpl::filesys::path& source, const qpl::filesys::path& destination) {
+	if (definitely_different(source, destination)) {
+		return false;
+	}
+	return source.file_content_equals(destination);
+}
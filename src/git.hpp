@@ -3,6 +3,10 @@
 #include <qpl/qpl.hpp>
 #include "info.hpp"
 #include "batch.hpp"
+#include "events.hpp"
+#include "porcelain.hpp"
+#include "prefetch.hpp"
+#include <fstream>
 
 void git(const qpl::filesys::path& path, const state& state, history_status& history) {
 	if (state.check_mode && !state.status) {
@@ -16,14 +20,14 @@ void git(const qpl::filesys::path& path, const state& state, history_status& his
 	if (!git_path.exists()) {
 		git_path = path;
 	}
+	std::lock_guard repository_lock(prefetch::repository_lock(git_path.string()));
 
 	qpl::filesys::path status_batch;
 	qpl::filesys::path exec_batch;
 
 	std::string status_data;
-	std::string status_display_data;
 	std::string exec_data;
-
+	bool display = false;
 
 	auto same_dir = qpl::filesys::get_current_location().string().front() == git_path.string().front();
 	auto set_directory = qpl::to_string(same_dir ? "cd " : "cd /D ", git_path);
@@ -33,90 +37,99 @@ void git(const qpl::filesys::path& path, const state& state, history_status& his
 	auto output_file = home.appended("output.txt");
 	output_file.create();
 
-	if (state.status) {
+	auto fetch = prefetch::fresh(git_path.string(), state.fetch_window) ? "" : " && git fetch";
+	auto pull_status = qpl::to_string("@echo off && ", set_directory, fetch, " && git status --porcelain=v2 --branch -z -uno > ", output_file);
+	auto push_status = qpl::to_string("@echo off && ", set_directory, " && git add -A && git status --porcelain=v2 --branch -z > ", output_file);
+
+	//hard-pull comes first, "status hard-pull" only lists what the reset would restore or remove.
+	if (state.hard_pull) {
+		//only what differs from HEAD is reset and only untracked files are cleaned, git skips files whose index stat data still matches.
+		status_batch = home.appended("git_reset_status.bat");
+		status_data = qpl::to_string("@echo off && ", set_directory, " && git status --porcelain=v2 --branch -z --untracked-files=all > ", output_file);
+		display = true;
+
+		if (!state.status) {
+			exec_batch = home.appended("git_reset.bat");
+			exec_data = qpl::to_string("@echo off && ", set_directory, " && @echo on && git reset --hard HEAD && git clean -f -d");
+		}
+	}
+	else if (state.status) {
+		status_batch = home.appended("git_status.bat");
+		display = true;
 		if (state.action == action::pull || state.action == action::both) {
-			status_batch = home.appended("git_status.bat");
-			status_display_data = qpl::to_string("@echo off && ", set_directory, " && git fetch && git status -uno");
-			status_data = qpl::to_string(status_display_data, " > ", output_file);
+			status_data = pull_status;
 		}
 		else if (state.action == action::push) {
-			status_batch = home.appended("git_status.bat");
-			status_display_data = qpl::to_string("@echo off && ", set_directory, " && git add -A && git status");
-			status_data = qpl::to_string(status_display_data, " > ", output_file);
+			status_data = push_status;
 		}
 	}
 	else if (state.action == action::pull) {
 		status_batch = home.appended("git_pull_status.bat");
-		status_data = qpl::to_string("@echo off && ", set_directory, " && git fetch && git status -uno > ", output_file);
+		status_data = pull_status;
 
 		exec_batch = home.appended("git_pull.bat");
 		exec_data = qpl::to_string("@echo off && ", set_directory, " && @echo on && git pull");
 	}
 	else if (state.action == action::push) {
 		status_batch = home.appended("git_push_status.bat");
-		status_display_data = qpl::to_string("@echo off && ", set_directory, " && git add -A && git status");
-		status_data = qpl::to_string(status_display_data, " > ", output_file);
+		status_data = push_status;
+		display = true;
 
 		exec_batch = home.appended("git_push.bat");
 		exec_data = qpl::to_string("@echo off && ", set_directory, " && git commit -m \"update\" && git push");
 	}
-	else if (state.hard_pull) {
-		auto list = git_path.list_current_directory();
-		for (auto& path : list) {
-			if (path.get_full_name() != ".git") {
-				path.remove();
-			}
-		}
-
-		exec_batch = home.appended("git_reset.bat");
-		exec_data = qpl::to_string("@echo off && ", set_directory, " && @echo on && git reset --hard HEAD && git clean -f -d");
-		execute_batch(exec_batch, exec_data);
-		return;
-	}
 
 	execute_batch(status_batch, status_data);
 
-	auto lines = qpl::split_string(output_file.read(), '\n');
-	if (lines.empty()) {
-		qpl::println("error : no output from git status.");
+	std::string output;
+	{
+		std::ifstream file(output_file.string(), std::ios::binary);
+		output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	auto& status = history.git;
+	if (!status.parse(std::move(output))) {
+		events::error("error : no output from git status.");
 		output_file.remove();
 		return;
 	}
-	
-	history.git_changes = true;
-	if (state.action == action::pull) {
-		if (lines.size() > 1) {
-			std::string search1 = "Your branch is up to date";
-			std::string search2 = "Your branch is ahead of";
-			auto case1 = qpl::string_equals_ignore_case(lines[1].substr(0u, search1.length()), search1);
-			auto case2 = qpl::string_equals_ignore_case(lines[1].substr(0u, search2.length()), search2);
-			history.git_changes = !(case1 || case2);
-		}
+
+	if (state.hard_pull) {
+		history.git_changes = status.dirty();
+	}
+	else if (state.action == action::pull) {
+		history.git_changes = status.behind > 0u;
 	}
 	else if (state.action == action::push) {
-		std::string search = "nothing to commit, working tree clean";
-		history.git_changes = !qpl::string_equals_ignore_case(lines.back(), search);
-
-		if (!history.git_changes && lines.size() > 1) {
-			std::string search = "Your branch is ahead of";
-			auto start = lines[1].substr(0u, search.length());
-			history.git_changes = qpl::string_equals_ignore_case(start, search);
-			
-			if (!state.status && history.git_changes) {
+		history.git_changes = status.dirty();
+
+		if (!history.git_changes && status.ahead) {
+			history.git_changes = true;
+
+			if (!state.status) {
 				exec_batch = home.appended("git_push.bat");
 				exec_data = qpl::to_string("@echo off && ", set_directory, " && git push");
 			}
 		}
 	}
+	else {
+		history.git_changes = status.dirty() || status.ahead || status.behind;
+	}
 
-
-	if (history.git_changes) {
-		if (!status_display_data.empty()) {
-			if (state.print) {
-				qpl::println();
-				execute_batch(status_batch, status_display_data);
+	auto event = make_event(event_type::git_result, state.check_mode, git_path);
+	event.changes = history.git_changes;
+	if (history.git_changes && display && state.print) {
+		event.message = status.summary();
+		for (auto& entry : status.entries) {
+			event.message += qpl::to_string('\n', entry.staged, entry.unstaged, ' ', entry.path);
+			if (!entry.original_path.empty()) {
+				event.message += qpl::to_string(" <- ", entry.original_path);
 			}
 		}
+	}
+	events::emit(std::move(event));
+
+	if (history.git_changes) {
+		events::flush();
 		if (!exec_data.empty()) {
 			execute_batch(exec_batch, exec_data);
 		}
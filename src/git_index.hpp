@@ -0,0 +1,271 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include "sha1.hpp"
+
+//reader for .git/index versions 2 to 4. a tracked file whose size and mtime still match its entry is
+//unchanged since the index was written, so its blob id is known without reading the file.
+//the blob id hashes the clean filtered content, it is only used for repositories where git converts nothing.
+namespace git_index {
+	struct entry {
+		qpl::u32 mtime_seconds = 0u;
+		qpl::u32 mtime_nanoseconds = 0u;
+		qpl::u32 size = 0u;
+		sha1_digest blob{};
+	};
+
+	struct index {
+		//mirror working tree the entries are relative to, normalized.
+		std::string repository;
+		std::filesystem::file_time_type time;
+		qpl::i64 time_seconds = 0;
+		std::unordered_map<std::string, entry> entries;
+		bool valid = false;
+		//autocrlf, core.eol or a text / eol / filter attribute may change content between work tree and blob.
+		bool converts = true;
+
+		static qpl::u32 read32(const qpl::u8* data) {
+			return (qpl::u32{ data[0] } << 24) | (qpl::u32{ data[1] } << 16) | (qpl::u32{ data[2] } << 8) | qpl::u32{ data[3] };
+		}
+		static qpl::u16 read16(const qpl::u8* data) {
+			return static_cast<qpl::u16>((data[0] << 8) | data[1]);
+		}
+
+		bool parse(const std::string& data) {
+			auto bytes = reinterpret_cast<const qpl::u8*>(data.data());
+			auto end = bytes + data.size();
+			if (data.size() < 12u || std::memcmp(bytes, "DIRC", 4u) != 0) {
+				return false;
+			}
+			auto version = read32(bytes + 4);
+			if (version < 2u || version > 4u) {
+				return false;
+			}
+			auto count = read32(bytes + 8);
+			auto position = bytes + 12;
+
+			std::string name;
+			for (qpl::u32 i = 0u; i < count; ++i) {
+				constexpr qpl::size fixed = 62u;
+				if (end - position < static_cast<std::ptrdiff_t>(fixed)) {
+					return false;
+				}
+				auto start = position;
+				entry entry;
+				entry.mtime_seconds = read32(position + 8);
+				entry.mtime_nanoseconds = read32(position + 12);
+				entry.size = read32(position + 36);
+				std::memcpy(entry.blob.data(), position + 40, 20u);
+				auto flags = read16(position + 60);
+				position += fixed;
+				if (version >= 3u && (flags & 0x4000u)) {
+					position += 2;
+				}
+
+				if (version == 4u) {
+					//the name is the previous name minus N trailing bytes plus a NUL terminated suffix.
+					qpl::u64 strip = 0u;
+					if (position >= end) {
+						return false;
+					}
+					auto c = *position++;
+					strip = c & 127u;
+					while (c & 128u) {
+						if (position >= end) {
+							return false;
+						}
+						c = *position++;
+						strip = ((strip + 1u) << 7) | (c & 127u);
+					}
+					if (strip > name.size()) {
+						return false;
+					}
+					name.resize(name.size() - strip);
+					auto terminator = std::find(position, end, qpl::u8{ 0 });
+					if (terminator == end) {
+						return false;
+					}
+					name.append(reinterpret_cast<const char*>(position), terminator - position);
+					position = terminator + 1;
+				}
+				else {
+					auto terminator = std::find(position, end, qpl::u8{ 0 });
+					if (terminator == end) {
+						return false;
+					}
+					name.assign(reinterpret_cast<const char*>(position), terminator - position);
+					//entries are NUL padded to a multiple of 8 bytes.
+					auto length = (terminator - start) + 1;
+					position = start + ((length + 7) / 8) * 8;
+				}
+
+				auto stage = (flags >> 12) & 3u;
+				if (stage == 0u) {
+					this->entries[name] = entry;
+				}
+			}
+			this->valid = true;
+			return true;
+		}
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, std::shared_ptr<const index>> indices;
+
+	//stdout of a short command, empty if it couldn't run.
+	std::string command_output(const std::string& command) {
+#if defined(_WIN32)
+		auto pipe = _popen((command + " 2>nul").c_str(), "r");
+#else
+		auto pipe = popen((command + " 2>/dev/null").c_str(), "r");
+#endif
+		std::string result;
+		if (!pipe) {
+			return result;
+		}
+		char buffer[256];
+		while (auto count = std::fread(buffer, 1u, sizeof(buffer), pipe)) {
+			result.append(buffer, count);
+		}
+#if defined(_WIN32)
+		_pclose(pipe);
+#else
+		pclose(pipe);
+#endif
+		return result;
+	}
+
+	//true if an attributes file sets text, eol, crlf, filter, ident or working-tree-encoding for any pattern.
+	bool converting_attributes(const std::string& path) {
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream stream(line);
+			std::string word;
+			if (!(stream >> word) || word.starts_with('#')) {
+				continue;
+			}
+			while (stream >> word) {
+				if (word.starts_with('-') || word.starts_with('!')) {
+					continue;
+				}
+				auto name = word.substr(0u, word.find('='));
+				if (name == "text" || name == "eol" || name == "crlf" || name == "filter" || name == "ident" || name == "working-tree-encoding") {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	//asks git for the effective (system, global and local) config, so the autocrlf default of git for windows is seen too.
+	bool converts(const std::string& repository, const index& index) {
+		auto config = command_output(qpl::to_string("git -C \"", repository, "\" config --get-regexp \"^core\\.(autocrlf|eol|attributesfile)$\""));
+		std::istringstream stream(config);
+		std::string key;
+		std::string value;
+		std::vector<std::string> attribute_files = { repository + ".git/info/attributes" };
+		while (stream >> key && std::getline(stream >> std::ws, value)) {
+			if (!value.empty() && value.back() == '\r') {
+				value.pop_back();
+			}
+			if (key == "core.autocrlf" && !qpl::string_equals_ignore_case(value, "false")) {
+				return true;
+			}
+			if (key == "core.eol") {
+				return true;
+			}
+			if (key == "core.attributesfile") {
+				if (value.starts_with("~/")) {
+					auto home = std::getenv("HOME") ? std::getenv("HOME") : std::getenv("USERPROFILE");
+					value = qpl::to_string(home ? home : "", value.substr(1u));
+				}
+				attribute_files.push_back(value);
+			}
+		}
+		for (auto& [name, entry] : index.entries) {
+			if (name == ".gitattributes" || name.ends_with("/.gitattributes")) {
+				attribute_files.push_back(repository + name);
+			}
+		}
+		for (auto& file : attribute_files) {
+			if (converting_attributes(file)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string normalized(std::string path) {
+		std::replace(path.begin(), path.end(), '\\', '/');
+		if (!path.empty() && path.back() != '/') {
+			path.push_back('/');
+		}
+		return path;
+	}
+
+	//parsed index of the repository, reloaded whenever the index file was rewritten. a move loads it once per pass.
+	std::shared_ptr<const index> load(std::string repository) {
+		repository = normalized(repository);
+		std::filesystem::path file = repository + ".git/index";
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(file, error);
+		if (error) {
+			return nullptr;
+		}
+
+		std::lock_guard lock(mutex);
+		auto& cached = indices[repository];
+		if (cached && cached->time == time) {
+			return cached;
+		}
+		std::ifstream stream(file, std::ios::binary);
+		std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+		auto result = std::make_shared<index>();
+		result->repository = repository;
+		result->time = time;
+		auto sys = std::chrono::file_clock::to_sys(time);
+		result->time_seconds = std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch()).count();
+		if (result->parse(data)) {
+			result->converts = converts(repository, *result);
+		}
+		cached = result;
+		return cached;
+	}
+
+	//blob id of a file inside the index's repository if its entry still matches size and mtime and git converts nothing.
+	//entries written in the same second as the index are racily clean and not trusted.
+	std::optional<sha1_digest> indexed_blob(const index& index, std::string path, qpl::u64 size, std::filesystem::file_time_type time) {
+		if (!index.valid || index.converts) {
+			return std::nullopt;
+		}
+		std::replace(path.begin(), path.end(), '\\', '/');
+		if (!path.starts_with(index.repository)) {
+			return std::nullopt;
+		}
+		auto found = index.entries.find(path.substr(index.repository.size()));
+		if (found == index.entries.cend()) {
+			return std::nullopt;
+		}
+		auto& entry = found->second;
+		if (entry.size != static_cast<qpl::u32>(size) || qpl::i64{ entry.mtime_seconds } >= index.time_seconds) {
+			return std::nullopt;
+		}
+		auto sys = std::chrono::file_clock::to_sys(time);
+		auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(sys.time_since_epoch()).count();
+		if (nanoseconds / 1'000'000'000 != qpl::i64{ entry.mtime_seconds }) {
+			return std::nullopt;
+		}
+		if (entry.mtime_nanoseconds && nanoseconds % 1'000'000'000 != qpl::i64{ entry.mtime_nanoseconds }) {
+			return std::nullopt;
+		}
+		return entry.blob;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <fstream>
+#include <cstring>
+
+constexpr qpl::u64 hash_seed = 0x9E3779B97F4A7C15ull;
+constexpr qpl::size hash_block_size = 1u << 16;
+
+constexpr qpl::u64 hash_mix(qpl::u64 x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+qpl::u64 hash_bytes(const char* data, qpl::size size, qpl::u64 seed = hash_seed) {
+	auto hash = seed ^ hash_mix(size);
+	qpl::size i = 0u;
+	for (; i + 8u <= size; i += 8u) {
+		qpl::u64 word;
+		std::memcpy(&word, data + i, 8u);
+		hash = hash_mix(hash ^ word) + hash_seed;
+	}
+	qpl::u64 tail = 0u;
+	std::memcpy(&tail, data + i, size - i);
+	return hash_mix(hash ^ tail ^ (qpl::u64{ size } << 56));
+}
+
+//streams the file in fixed blocks, so the digest only depends on the content.
+std::optional<qpl::u64> file_hash(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return std::nullopt;
+	}
+	std::vector<char> buffer(hash_block_size);
+	auto hash = hash_seed;
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		auto read = static_cast<qpl::size>(file.gcount());
+		if (!read) {
+			break;
+		}
+		hash = hash_bytes(buffer.data(), read, hash);
+	}
+	return hash;
+}
@@ -1,10 +1,11 @@
 #pragma once
 
 #include <qpl/qpl.hpp>
+#include <atomic>
 #include "state.hpp"
 
 namespace info {
-	qpl::size total_change_sum = 0u;
+	std::atomic_size_t total_change_sum = 0u;
 	constexpr auto print_space = 40;
 
 	void total_reset() {
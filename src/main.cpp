@@ -1,5 +1,6 @@
 #include <qpl/qpl.hpp>
 #include "autogit.hpp"
+#include "probe.hpp"
 
 bool input_state(state& state, const std::string& input, const autogit& autogit) {
 	auto split = qpl::split_string_whitespace(input);
@@ -10,12 +11,20 @@ bool input_state(state& state, const std::string& input, const autogit& autogit)
 	bool abort = false;
 	state.reset();
 
+	//options beyond the original keywords always carry a "name=" prefix, so no directory name is shadowed by them.
+	auto option = [](const std::string& arg, const std::string& name) {
+		return arg.size() > name.size() && qpl::string_starts_with_ignore_case(arg, name + '=');
+	};
+	auto value = [](const std::string& arg) {
+		return arg.substr(arg.find('=') + 1);
+	};
+
 	for (auto& arg : split) {
 		if (qpl::string_equals_ignore_case(arg, "check")) {
 			state.check_mode = true;
 		}
-		else if (qpl::string_equals_ignore_case(arg, "quick")) {
-			state.quick_mode = true;
+		else if (option(arg, "detect") && detection_from_string(value(arg)).has_value()) {
+			state.detection = detection_from_string(value(arg)).value();
 		}
 		else if (qpl::string_equals_ignore_case(arg, "local")) {
 			state.location = location::local;
@@ -38,27 +47,66 @@ bool input_state(state& state, const std::string& input, const autogit& autogit)
 		else if (qpl::string_equals_ignore_case(arg, "hard-pull")) {
 			state.hard_pull = true;
 		}
+		else if (option(arg, "show") && qpl::string_equals_ignore_case(value(arg), "history")) {
+			state.report = true;
+		}
+		else if (option(arg, "show") && qpl::string_equals_ignore_case(value(arg), "snapshots")) {
+			state.list_snapshots = true;
+		}
+		else if (option(arg, "apply") && qpl::string_equals_ignore_case(value(arg), "staged")) {
+			state.staged = true;
+		}
+		else if (option(arg, "apply") && qpl::string_equals_ignore_case(value(arg), "snapshot")) {
+			state.snapshot = true;
+		}
+		else if (option(arg, "apply") && qpl::string_equals_ignore_case(value(arg), "verify")) {
+			state.verify_copies = true;
+		}
+		else if (option(arg, "stream") && qpl::string_equals_ignore_case(value(arg), "on")) {
+			state.streaming = true;
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "stream=") && qpl::is_string_number(arg.substr(7u))) {
+			state.streaming = true;
+			state.memory_limit = qpl::size_cast(arg.substr(7u)) << 20;
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "fresh=") && qpl::is_string_number(arg.substr(6u))) {
+			state.fetch_window = qpl::size_cast(arg.substr(6u));
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "limit=") && qpl::is_string_number(arg.substr(6u))) {
+			state.io_bytes_limit = qpl::size_cast(arg.substr(6u)) << 20;
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "iops=") && qpl::is_string_number(arg.substr(5u))) {
+			state.io_operations_limit = qpl::size_cast(arg.substr(5u));
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "chunk=") && qpl::is_string_number(arg.substr(6u))) {
+			state.chunk_threshold = qpl::size_cast(arg.substr(6u)) << 20;
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "copythreads=") && qpl::is_string_number(arg.substr(12u))) {
+			state.copy_threads = qpl::size_cast(arg.substr(12u));
+		}
+		else if (option(arg, "restore")) {
+			state.restore = true;
+			if (!qpl::string_equals_ignore_case(value(arg), "last")) {
+				state.restore_id = value(arg);
+			}
+		}
+		else if (qpl::string_starts_with_ignore_case(arg, "keep=") && qpl::is_string_number(arg.substr(5u))) {
+			state.snapshot_keep = qpl::size_cast(arg.substr(5u));
+		}
+		else if (option(arg, "output") && qpl::string_equals_ignore_case(value(arg), "quiet")) {
+			state.render = render_mode::quiet;
+		}
+		else if (option(arg, "output") && qpl::string_equals_ignore_case(value(arg), "json")) {
+			state.render = render_mode::json;
+		}
 		else {
 			if (arg.length() > 1 && arg.starts_with('"') && arg.back() == '"') {
 				arg = arg.substr(1u, arg.length() - 2u);
 			}
-			std::vector<std::string> list;
-			for (auto& i : autogit.directories) {
-				if (i.directory_name.length() >= arg.length()) {
-					list.push_back(i.directory_name.substr(0u, arg.length()));
-				}
-				else {
-					list.push_back("");
-				}
-			}
-			auto best_match_indices = qpl::best_string_matches_indices(list, arg);
-
-			bool started_match = false;
-			for (auto& i : list) {
-				if (qpl::string_starts_with_ignore_case(i, arg)) {
-					started_match = true;
-					break;
-				}
+			auto best_match_indices = autogit.index.prefix(arg);
+			bool started_match = !best_match_indices.empty();
+			if (!started_match) {
+				best_match_indices = autogit.index.fuzzy(arg);
 			}
 
 			qpl::filesys::path target;
@@ -66,7 +114,10 @@ bool input_state(state& state, const std::string& input, const autogit& autogit)
 			if (!started_match) {
 				qpl::println("couldn't find a directory named \"", arg, "\".");
 
-				if (best_match_indices.size() > 1) {
+				if (best_match_indices.empty()) {
+					abort = true;
+				}
+				else if (best_match_indices.size() > 1) {
 					while (true) {
 						qpl::println("select the right location: [enter to go back] \n");
 						for (qpl::size i = 0u; i < best_match_indices.size(); ++i) {
@@ -133,7 +184,8 @@ bool input_state(state& state, const std::string& input, const autogit& autogit)
 	if (abort) {
 		return false;
 	}
-	if (state.action == action::both && !(state.status || state.update || state.hard_pull)) {
+	bool snapshots = state.restore || state.list_snapshots || state.snapshot_keep;
+	if (state.action == action::both && !(state.status || state.update || state.hard_pull || state.report || snapshots)) {
 		qpl::println("\"", split, "\" invalid arguments.\n");
 		return false;
 	}
@@ -165,6 +217,25 @@ void print_commands() {
 	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
 	qpl::println(qpl::color::aqua, "hard-pull  . . ", ">> ", "hard resets git and runs ", pl, "pull", ".");
 	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "show=history . ", ">> ", "shows recorded run times and their trend per directory.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "apply=staged . ", ">> ", "copies into a staging area first, then replaces files by rename.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "stream=on|MB . ", ">> ", "streams huge trees, collision lists above MB spill to disk.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "fresh=SEC. . . ", ">> ", "skips git fetch if the last fetch is younger than SEC, default 120.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "limit=MB iops=N", ">> ", "limits copies, compares and removes to MB/s and N operations/s.");
+	qpl::println(qpl::color::aqua, "chunk=MB . . . ", ">> ", "copies files from MB (default 256, 0 = off) in parallel chunks, ", u, "copythreads=N", ", ", u, "apply=verify", ".");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "apply=snapshot ", ">> ", "keeps overwritten and removed files and skips the confirmation.");
+	qpl::println(qpl::color::aqua, "show=snapshots ", ">> ", "lists the snapshots, ", u, "keep=N", " removes all but the newest N.");
+	qpl::println(qpl::color::aqua, "restore=last|ID", ">> ", "copies the files of the newest (or ID) snapshot back.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "output=MODE. . ", ">> ", u, "quiet", " hides file events, ", u, "json", " prints them as json lines.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
+	qpl::println(qpl::color::aqua, "detect=TIER. . ", ">> ", "compares by ", u, "stat", " (", u, "quick", "), ", u, "inode", ", ", u, "hash", " or ", u, "full", " content.");
+	qpl::println(qpl::color::gray, qpl::to_string_repeat("- ", seperation_width));
 	qpl::println(qpl::color::aqua, "[directory]. . ", ">> ", "runs any command ONLY on that directory.");
 	qpl::println();
 	qpl::println("combine them, e.g. \"local status\", \"git pull\", \"local push status\".\n");
@@ -174,7 +245,10 @@ void input_state(state& state, const autogit& autogit) {
 	while (true) {
 
 		qpl::print("command > ");
+		prefetch::idle = true;
 		auto input = qpl::get_input();
+		prefetch::idle = false;
+		autogit.wait_discovery();
 
 		if (input_state(state, input, autogit)) {
 			return;
@@ -182,15 +256,16 @@ void input_state(state& state, const autogit& autogit) {
 	}
 }
 
-std::vector<std::string> find_location() {
+std::vector<location_path> find_location() {
 	auto lines = qpl::split_string(qpl::read_file("paths.cfg"), '\n');
 
 	for (auto& line : lines) {
 		qpl::remove_multiples(line, '\r');
 	}
 
-	std::vector<std::vector<std::string>> locations;
+	std::vector<std::vector<location_path>> locations;
 	std::vector<std::string> location_names;
+	location_path location_defaults;
 	for (qpl::size i = 0u; i < lines.size(); ++i) {
 		if (lines[i].empty()) {
 			continue;
@@ -198,30 +273,80 @@ std::vector<std::string> find_location() {
 		if (lines[i].back() == '{') {
 			locations.push_back({});
 			location_names.push_back(qpl::split_string_words(lines[i]).front());
+
+			location_defaults = location_path{};
+			auto colon = lines[i].find(':');
+			if (colon != std::string::npos) {
+				apply_location_options(location_defaults, lines[i].substr(colon + 1, lines[i].length() - colon - 2));
+			}
 		}
 		else if (lines[i].front() != '}') {
 			qpl::size index = 0u;
 			while (index < lines[i].size() && qpl::is_character_whitespace(lines[i][index])) {
 				++index;
 			}
-			locations.back().push_back(lines[i].substr(index));
+			auto location = location_defaults;
+			location.path = lines[i].substr(index);
+
+			auto options = location.path.find('|');
+			if (options != std::string::npos) {
+				apply_location_options(location, location.path.substr(options + 1));
+				location.path = location.path.substr(0u, options);
+				while (!location.path.empty() && qpl::is_character_whitespace(location.path.back())) {
+					location.path.pop_back();
+				}
+			}
+			locations.back().push_back(location);
 		}
 	}
 
 	qpl::size best_index = 0u;
-	std::vector<std::string> result;
-	for (qpl::size i = 0u; i < locations.size(); ++i) {
-		bool found = true;
-		for (auto& p : locations[i]) {
-			if (!qpl::filesys::exists(p)) {
-				found = false;
-				break;
+	std::vector<location_path> result;
+
+	auto paths_of = [&](qpl::size index) {
+		std::vector<std::string> paths;
+		for (auto& p : locations[index]) {
+			paths.push_back(p.path);
+		}
+		return paths;
+	};
+	auto all_found = [](const std::vector<bool>& found) {
+		return std::all_of(found.cbegin(), found.cend(), [](bool b) { return b; });
+	};
+
+	//the location that matched last time is probed on its own first, on a known machine that is the only round.
+	auto last = probe::last_location();
+	if (last.has_value()) {
+		auto it = std::find(location_names.cbegin(), location_names.cend(), last.value());
+		if (it != location_names.cend()) {
+			auto index = qpl::size_cast(it - location_names.cbegin());
+			if (all_found(probe::exists(paths_of(index)))) {
+				result = locations[index];
+				best_index = index;
 			}
 		}
-		if (found) {
-			result = locations[i];
-			best_index = i;
-			break;
+	}
+
+	std::vector<std::vector<bool>> found;
+	if (result.empty()) {
+		std::vector<std::string> paths;
+		for (qpl::size i = 0u; i < locations.size(); ++i) {
+			auto list = paths_of(i);
+			paths.insert(paths.end(), list.begin(), list.end());
+		}
+		auto exists = probe::exists(paths);
+
+		qpl::size offset = 0u;
+		for (auto& location : locations) {
+			found.emplace_back(exists.begin() + offset, exists.begin() + offset + location.size());
+			offset += location.size();
+		}
+		for (qpl::size i = 0u; i < locations.size(); ++i) {
+			if (all_found(found[i])) {
+				result = locations[i];
+				best_index = i;
+				break;
+			}
 		}
 	}
 	if (result.empty()) {
@@ -229,12 +354,7 @@ std::vector<std::string> find_location() {
 
 		for (qpl::size i = 0u; i < locations.size(); ++i) {
 			counts[i].first = i;
-			counts[i].second = 0u;
-			for (auto& p : locations[i]) {
-				if (qpl::filesys::exists(p)) {
-					++counts[i].second;
-				}
-			}
+			counts[i].second = qpl::size_cast(std::count(found[i].cbegin(), found[i].cend(), true));
 		}
 
 		qpl::sort(counts, [](auto a, auto b) {
@@ -243,8 +363,9 @@ std::vector<std::string> find_location() {
 
 		best_index = counts.front().first;
 		qpl::println("paths.cfg : couldn't find the right location.\nBest match is location \"", location_names[best_index], "\": ");
-		for (auto& i : locations[best_index]) {
-			if (qpl::filesys::exists(i)) {
+		for (qpl::size p = 0u; p < locations[best_index].size(); ++p) {
+			auto& i = locations[best_index][p];
+			if (found[best_index][p]) {
 				qpl::set_console_color(qpl::foreground::light_green);
 				qpl::print("FOUND     ");
 			}
@@ -253,11 +374,12 @@ std::vector<std::string> find_location() {
 				qpl::print("NOT FOUND ");
 			}
 			qpl::set_console_color_default();
-			qpl::println(" -- ", i, " ]");
+			qpl::println(" -- ", i.path, " ]");
 		}
 		qpl::system_pause();
 	}
 	else {
+		probe::set_last_location(location_names[best_index]);
 		qpl::println(qpl::color::gray, qpl::to_string("location = \"", location_names[best_index], "\""));
 	}
 
@@ -297,16 +419,18 @@ int main(int argc, char** argv) try {
 		return 0;
 	}
 
+	events::stream.start();
+	progress::display.start();
+
 	autogit autogit;
-	autogit.find_directories(location);
-	autogit.print();
-	qpl::println();
+	autogit.discover(location);
 
 	if (argc > 1) {
 		std::vector<std::string> args(argc - 1);
 		for (qpl::isize i = 0; i < argc - 1; ++i) {
 			args[i] = argv[i + 1];
 		}
+		autogit.wait_discovery();
 		run(args, autogit);
 	}
 	else {
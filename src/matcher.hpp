@@ -0,0 +1,131 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <unordered_map>
+
+//case folded lookup of directories by name or by path below their location root, so a drive letter or a shared
+//root doesn't match every directory. a prefix trie answers "starts with" and
+//a trigram index ranks fuzzy suggestions, so neither has to score every directory per argument.
+struct directory_index {
+	struct node {
+		std::unordered_map<char, qpl::u32> children;
+		std::vector<qpl::size> ids;
+	};
+	std::vector<node> nodes = std::vector<node>(1u);
+	std::unordered_map<std::string, std::vector<qpl::size>> grams;
+	std::vector<std::string> names;
+	std::vector<qpl::size> gram_counts;
+
+	static std::string fold(std::string string) {
+		for (auto& c : string) {
+			c = (c == '\\') ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+		return string;
+	}
+	//trigrams of the padded string, so one and two letter arguments still produce grams.
+	static std::vector<std::string> trigrams(const std::string& folded) {
+		std::vector<std::string> result;
+		auto padded = qpl::to_string("  ", folded, ' ');
+		for (qpl::size i = 0u; i + 3u <= padded.size(); ++i) {
+			auto gram = padded.substr(i, 3u);
+			if (std::find(result.cbegin(), result.cend(), gram) == result.cend()) {
+				result.push_back(std::move(gram));
+			}
+		}
+		return result;
+	}
+
+	void clear() {
+		*this = directory_index{};
+	}
+	void insert_prefix(const std::string& folded, qpl::size id) {
+		qpl::u32 current = 0u;
+		for (auto c : folded) {
+			auto found = this->nodes[current].children.find(c);
+			if (found == this->nodes[current].children.cend()) {
+				this->nodes.emplace_back();
+				auto next = static_cast<qpl::u32>(this->nodes.size() - 1);
+				this->nodes[current].children[c] = next;
+				current = next;
+			}
+			else {
+				current = found->second;
+			}
+		}
+		this->nodes[current].ids.push_back(id);
+	}
+	void add(qpl::size id, const std::string& name, const std::string& path) {
+		auto folded = fold(name);
+		this->insert_prefix(folded, id);
+		if (!path.empty()) {
+			this->insert_prefix(fold(path), id);
+		}
+
+		auto list = trigrams(folded);
+		for (auto& gram : list) {
+			this->grams[gram].push_back(id);
+		}
+		if (this->names.size() <= id) {
+			this->names.resize(id + 1);
+			this->gram_counts.resize(id + 1);
+		}
+		this->names[id] = std::move(folded);
+		this->gram_counts[id] = list.size();
+	}
+
+	//every id whose name or relative path starts with the argument, shortest name first.
+	std::vector<qpl::size> prefix(const std::string& string) const {
+		std::vector<qpl::size> result;
+		qpl::u32 current = 0u;
+		for (auto c : fold(string)) {
+			auto found = this->nodes[current].children.find(c);
+			if (found == this->nodes[current].children.cend()) {
+				return result;
+			}
+			current = found->second;
+		}
+		std::vector<qpl::u32> stack = { current };
+		while (!stack.empty()) {
+			auto& node = this->nodes[stack.back()];
+			stack.pop_back();
+			result.insert(result.end(), node.ids.cbegin(), node.ids.cend());
+			for (auto& [c, child] : node.children) {
+				stack.push_back(child);
+			}
+		}
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		std::stable_sort(result.begin(), result.end(), [&](auto a, auto b) {
+			return this->names[a].length() < this->names[b].length();
+			});
+		return result;
+	}
+
+	//the ids with the highest trigram similarity to the argument, empty if none share a trigram.
+	std::vector<qpl::size> fuzzy(const std::string& string) const {
+		auto list = trigrams(fold(string));
+		std::unordered_map<qpl::size, qpl::size> shared;
+		for (auto& gram : list) {
+			auto found = this->grams.find(gram);
+			if (found != this->grams.cend()) {
+				for (auto id : found->second) {
+					++shared[id];
+				}
+			}
+		}
+		std::vector<qpl::size> result;
+		qpl::f64 best = 0.0;
+		for (auto& [id, count] : shared) {
+			auto score = static_cast<qpl::f64>(count) / (list.size() + this->gram_counts[id] - count);
+			if (score > best) {
+				best = score;
+				result.clear();
+			}
+			if (score == best) {
+				result.push_back(id);
+			}
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+};
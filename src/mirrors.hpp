@@ -0,0 +1,292 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <fstream>
+#include "state.hpp"
+#include "events.hpp"
+#include "access.hpp"
+#include "walker.hpp"
+#include "throttle.hpp"
+#include "progress.hpp"
+#include "move.hpp"
+
+//backup copies of a working directory next to its git mirror, "mirror=<path>" in paths.cfg. every push also brings
+//<path>/<directory path below the location root>/ up to date: the push's own walk over the source serves all mirrors and each
+//out of date file is read once and written to every mirror that needs it. a mirror file is out of date if its size or write time differ.
+namespace mirrors {
+	struct result {
+		std::string root;
+		qpl::size added = 0u;
+		qpl::size modified = 0u;
+		qpl::size removed = 0u;
+		qpl::u64 bytes = 0u;
+
+		bool clean() const {
+			return !this->added && !this->modified && !this->removed;
+		}
+	};
+
+	bool out_of_date(const entry_stat& source, const std::optional<entry_stat>& target) {
+		if (!target.has_value() || target->directory != source.directory) {
+			return true;
+		}
+		return !source.directory && (target->size != source.size || target->time != source.time);
+	}
+
+	//streams source once into a temporary file next to every destination. each is renamed over its destination only
+	//once the whole source was read and written, a failed copy leaves the previous backup untouched.
+	bool copy_to_all(const std::string& source, const std::vector<std::string>& destinations, qpl::u64 size, std::filesystem::file_time_type time) {
+		std::ifstream input(source, std::ios::binary);
+		if (!input.is_open()) {
+			events::error(qpl::to_string("MIRROR : couldn't read ", source));
+			return false;
+		}
+		std::vector<std::string> temporaries;
+		std::vector<std::ofstream> outputs;
+		temporaries.reserve(destinations.size());
+		outputs.reserve(destinations.size());
+		for (auto& destination : destinations) {
+			throttle::io(size);
+			temporaries.push_back(destination + ".autogit_partial");
+			outputs.emplace_back(temporaries.back(), std::ios::binary | std::ios::trunc);
+		}
+
+		qpl::u64 read = 0u;
+		std::vector<char> buffer(hash_block_size);
+		while (input) {
+			input.read(buffer.data(), buffer.size());
+			auto count = input.gcount();
+			for (auto& output : outputs) {
+				output.write(buffer.data(), count);
+			}
+			read += static_cast<qpl::u64>(count);
+			progress::copied(static_cast<qpl::u64>(count) * outputs.size());
+		}
+		bool complete = !input.bad() && read == size;
+		if (!complete) {
+			events::error(qpl::to_string("MIRROR : couldn't read all of ", source, ", ", read, " of ", size, " bytes."));
+		}
+
+		bool success = complete;
+		for (qpl::size i = 0u; i < outputs.size(); ++i) {
+			outputs[i].close();
+			std::error_code error;
+			if (!complete || !outputs[i]) {
+				if (complete) {
+					events::error(qpl::to_string("MIRROR : couldn't write ", destinations[i]));
+					success = false;
+				}
+				std::filesystem::remove(std::filesystem::path(temporaries[i]), error);
+				continue;
+			}
+			sync_metadata(source, temporaries[i], time);
+			std::filesystem::rename(std::filesystem::path(temporaries[i]), std::filesystem::path(destinations[i]), error);
+			if (error) {
+				events::error(qpl::to_string("MIRROR : couldn't replace ", destinations[i], " : ", error.message()));
+				std::filesystem::remove(std::filesystem::path(temporaries[i]), error);
+				success = false;
+			}
+		}
+		return success;
+	}
+
+	//path may name a directory with a trailing '/' where the mirror has a file.
+	void remove(std::string path) {
+		throttle::io(0u);
+		if (path.size() > 1u && path.back() == '/') {
+			path.pop_back();
+		}
+		std::error_code error;
+		std::filesystem::remove_all(std::filesystem::path(path), error);
+		if (error) {
+			events::error(qpl::to_string("MIRROR : couldn't remove ", path, " : ", error.message()));
+		}
+	}
+
+	//one source entry and its counterpart in every mirror.
+	struct fanout_entry {
+		std::string source;
+		entry_stat source_stat;
+		std::vector<std::string> targets;
+		std::vector<std::optional<entry_stat>> target_stats;
+	};
+
+	//brings every mirror root up to date with source_root one source directory at a time. on push, move() hands it
+	//each source directory it lists, so one walk serves git/ and all mirrors. in check mode nothing is written.
+	struct fanout {
+		std::string source_root;
+		std::vector<std::string> roots;
+		const ::state& state;
+		history_status& history;
+		std::vector<result> results;
+		//source directories below an entry the mirrors skip, the move walk may still list them.
+		std::vector<std::string> skipped;
+		bool reached = false;
+
+		fanout(const std::string& source_root, const std::vector<std::string>& roots, const ::state& state, history_status& history) :
+			source_root(source_root), roots(roots), state(state), history(history), results(roots.size()) {
+			for (qpl::size i = 0u; i < roots.size(); ++i) {
+				this->results[i].root = roots[i];
+				if (!state.check_mode) {
+					std::error_code error;
+					std::filesystem::create_directories(std::filesystem::path(roots[i]), error);
+				}
+			}
+		}
+
+		//returns whether a source directory is mirrored and its entries should follow.
+		bool apply(fanout_entry& entry, bool top_level) {
+			if (this->history.find_ignored_root(entry.source)) {
+				return false;
+			}
+			//the top level skips what a push wouldn't touch either.
+			if (top_level && !can_touch_working(entry.source)) {
+				return false;
+			}
+			std::vector<std::string> copies;
+			for (qpl::size i = 0u; i < entry.targets.size(); ++i) {
+				auto& target = entry.target_stats[i];
+				if (!out_of_date(entry.source_stat, target)) {
+					continue;
+				}
+				auto& destination = entry.targets[i];
+				if (target.has_value()) {
+					++this->results[i].modified;
+				}
+				else {
+					++this->results[i].added;
+				}
+				if (!entry.source_stat.directory) {
+					this->results[i].bytes += entry.source_stat.size;
+				}
+				if (this->state.print) {
+					auto event = make_event(target.has_value() ? event_type::modified : event_type::added, this->state.check_mode, destination);
+					event.size = qpl::signed_cast(entry.source_stat.size) - (target.has_value() ? qpl::signed_cast(target->size) : 0);
+					events::emit(std::move(event));
+				}
+				if (this->state.check_mode) {
+					continue;
+				}
+				if (target.has_value() && target->directory != entry.source_stat.directory) {
+					remove(destination);
+				}
+				if (entry.source_stat.directory) {
+					std::error_code error;
+					std::filesystem::create_directories(std::filesystem::path(destination), error);
+				}
+				else {
+					copies.push_back(destination);
+				}
+			}
+			if (!copies.empty()) {
+				copy_to_all(entry.source, copies, entry.source_stat.size, entry.source_stat.time);
+			}
+			return true;
+		}
+		void removed(qpl::size index, const std::string& path, const entry_stat& stat, bool top_level) {
+			if (top_level && !can_touch_working(path)) {
+				return;
+			}
+			++this->results[index].removed;
+			if (this->state.print) {
+				events::emit(make_event(event_type::removed, this->state.check_mode, path));
+			}
+			if (!this->state.check_mode) {
+				remove(path);
+			}
+		}
+
+		//one source directory with its listing: the same directory is listed in every mirror, out of date entries are
+		//copied and mirror entries without a source are removed. walk = descend here instead of following a walk.
+		void directory(const std::string& source_directory, const std::vector<entry_stat>& source_entries, bool walk) {
+			if (!source_directory.starts_with(this->source_root)) {
+				return;
+			}
+			auto relative = source_directory.substr(this->source_root.size());
+			bool top_level = relative.empty();
+			if (top_level) {
+				this->reached = true;
+			}
+			for (auto& skipped : this->skipped) {
+				if (source_directory.starts_with(skipped)) {
+					return;
+				}
+			}
+
+			std::vector<std::unordered_map<std::string, entry_stat>> target_entries(this->roots.size());
+			for (qpl::size i = 0u; i < this->roots.size(); ++i) {
+				for (auto& entry : read_directory(this->roots[i] + relative)) {
+					auto name = entry.name;
+					target_entries[i].emplace(std::move(name), std::move(entry));
+				}
+			}
+
+			std::vector<std::string> subdirectories;
+			for (auto& entry : source_entries) {
+				auto suffix = entry.directory ? entry.name + '/' : entry.name;
+
+				fanout_entry item;
+				item.source = source_directory + suffix;
+				item.source_stat = entry;
+				item.targets.reserve(this->roots.size());
+				item.target_stats.resize(this->roots.size());
+				for (qpl::size i = 0u; i < this->roots.size(); ++i) {
+					item.targets.push_back(this->roots[i] + relative + suffix);
+					auto found = target_entries[i].find(entry.name);
+					if (found != target_entries[i].cend()) {
+						item.target_stats[i] = std::move(found->second);
+						target_entries[i].erase(found);
+					}
+				}
+				if (!this->apply(item, top_level)) {
+					if (entry.directory) {
+						this->skipped.push_back(item.source);
+					}
+				}
+				//the move walk of a push doesn't enter what git/ doesn't take, those directories are walked here.
+				else if (entry.directory && (walk || (top_level && !can_touch_git(item.source)))) {
+					subdirectories.push_back(item.source);
+				}
+			}
+			for (qpl::size i = 0u; i < this->roots.size(); ++i) {
+				for (auto& [name, entry] : target_entries[i]) {
+					this->removed(i, this->roots[i] + relative + (entry.directory ? name + '/' : name), entry, top_level);
+				}
+			}
+			for (auto& subdirectory : subdirectories) {
+				this->walk(subdirectory);
+			}
+		}
+		void walk(const std::string& source_directory) {
+			this->directory(source_directory, read_directory(source_directory), true);
+		}
+		//hook for move(), the walk lists the source directory.
+		void follow(const std::string& source_directory, const std::vector<entry_stat>& source_entries) {
+			this->directory(source_directory, source_entries, false);
+		}
+		//walks the source alone if no move walk reached it, e.g. when the move was replayed from a speculative pass.
+		std::vector<result> finish() {
+			if (!this->reached) {
+				this->walk(this->source_root);
+			}
+			return this->results;
+		}
+	};
+
+	//one row per mirror, the columns line up so the mirrors can be compared at a glance.
+	void print(const std::vector<result>& results) {
+		qpl::size width = 0u;
+		for (auto& result : results) {
+			width = qpl::max(width, result.root.size());
+		}
+		for (auto& result : results) {
+			if (result.clean()) {
+				qpl::println(qpl::color::gray, "mirror ", qpl::str_rspaced(result.root, width), " : synchronized.");
+				continue;
+			}
+			qpl::println(qpl::color::light_yellow, "mirror ", qpl::str_rspaced(result.root, width), " : ",
+				qpl::str_lspaced(qpl::to_string('+', result.added), 7), qpl::str_lspaced(qpl::to_string('~', result.modified), 7),
+				qpl::str_lspaced(qpl::to_string('-', result.removed), 7), qpl::str_lspaced(qpl::memory_size_string(result.bytes), 12));
+		}
+	}
+}
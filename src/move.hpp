@@ -1,289 +1,419 @@
 #pragma once
 
 #include <qpl/qpl.hpp>
+#include <functional>
 #include "state.hpp"
 #include "info.hpp"
 #include "access.hpp"
+#include "events.hpp"
+#include "detection.hpp"
+#include "compare.hpp"
+#include "staging.hpp"
+#include "removal.hpp"
+#include "walker.hpp"
+#include "summary.hpp"
+#include "snapshot.hpp"
+#include "alloc.hpp"
+#include "progress.hpp"
+#include "chunked.hpp"
 
-std::string time_diff_string(std::filesystem::file_time_type time1, std::filesystem::file_time_type time2, bool show_time_stamp) {
-
-	auto ns1 = std::chrono::duration_cast<std::chrono::nanoseconds>(time1.time_since_epoch()).count();
-	auto ns2 = std::chrono::duration_cast<std::chrono::nanoseconds>(time2.time_since_epoch()).count();
+void copy_file(const qpl::filesys::path& source, const qpl::filesys::path& destination, qpl::u64 size, const state& state, history_status& history) {
+	if (state.staged) {
+		history.staged_copies.push_back(std::make_pair(source.string(), destination.string()));
+	}
+	else {
+		throttle::io(size);
+		chunked_copy::copy_overwrite(source, destination, size);
+	}
+}
 
-	bool negative = ns2 < ns1;
-	if (negative) {
-		std::swap(ns1, ns2);
-		std::swap(time1, time2);
+//content is known to be equal, only the write time (and the permissions where they differ) are applied.
+void sync_metadata(const qpl::filesys::path& source, const qpl::filesys::path& destination, std::filesystem::file_time_type time) {
+	std::filesystem::path destination_path = destination.string();
+	std::error_code error;
+	std::filesystem::last_write_time(destination_path, time, error);
+	if (error) {
+		events::error(qpl::to_string("MOVE : couldn't set the time of ", destination, " : ", error.message()));
+		return;
+	}
+	auto permissions = std::filesystem::status(std::filesystem::path(source.string()), error).permissions();
+	if (!error && std::filesystem::status(destination_path, error).permissions() != permissions) {
+		std::filesystem::permissions(destination_path, permissions, error);
 	}
+}
+
+//the per-file flags of a move as compile time constants. apply = not check mode, render = print,
+//collisions = find_collisions. instantiations without render build no events.
+template<bool apply_, bool render_, bool collisions_>
+struct move_policy {
+	static constexpr bool apply = apply_;
+	static constexpr bool render = render_;
+	static constexpr bool collisions = collisions_;
+};
 
-	auto diff = qpl::time(ns2 - ns1).string_short("");
-	auto time_stamp = qpl::get_time_string(time2, "%Y-%m-%d %H-%M-%S");
-	auto diff_str = qpl::to_string("( ", negative ? '-' : '+', ' ', diff, " )");
-	if (show_time_stamp) {
-		return qpl::to_string(time_stamp, ' ', diff_str);
+//calls function(move_policy<...>{}) with the instantiation matching state.
+template<typename F>
+void with_move_policy(const state& state, F&& function) {
+	auto select = [&]<bool apply, bool render>() {
+		if (state.find_collisions) {
+			function(move_policy<apply, render, true>{});
+		}
+		else {
+			function(move_policy<apply, render, false>{});
+		}
+	};
+	if (state.check_mode) {
+		state.print ? select.template operator()<false, true>() : select.template operator()<false, false>();
 	}
 	else {
-		return diff_str;
+		state.print ? select.template operator()<true, true>() : select.template operator()<true, false>();
 	}
 }
 
-void perform_move(const qpl::filesys::path& source, const qpl::filesys::path& destination, const state& state, history_status& history) {
-	if (history.find_ignored_root(source.ensured_directory_backslash())) {
-		if (print_ignore && history.find_ignored(source.ensured_directory_backslash())) {
-			if (state.print) {
-				if (!history.any_output) qpl::println();
-				auto word = state.check_mode ? "[*]IGNORED " : "IGNORED ";
-				qpl::println(qpl::str_lspaced(word, info::print_space), source);
-				history.any_output = true;
+template<typename Policy>
+void perform_move(const move_entry& entry, const state& state, history_status& history, const git_index::index* index) {
+	constexpr bool check_mode = !Policy::apply;
+	auto& source = entry.source;
+	auto& destination = entry.destination;
+
+	//streaming traversals find removables per directory and never need the checked set.
+	auto check = [&]() {
+		if (!state.streaming) {
+			history.check(destination);
+		}
+	};
+
+	if (history.find_ignored_root(source)) {
+		if constexpr (print_ignore && Policy::render) {
+			if (history.find_ignored(source)) {
+				events::emit(make_event(event_type::ignored, check_mode, source));
 			}
 		}
-		history.checked.insert(destination);
+		check();
 		return;
 	}
 
-	if (source.is_directory()) {
-		if (!destination.exists()) {
+	if (entry.source_stat.directory) {
+		if (!entry.destination_stat.has_value()) {
 			history.move_changes = true;
-			if (state.print) {
-				if (!history.any_output) qpl::println();
-
-				auto word = state.check_mode ? "[*]NEW   " : "NEW DIR";
-				auto str = qpl::str_lspaced(qpl::to_string(word, " + ", qpl::memory_size_string(source.file_size_recursive())), info::print_space);
-				qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, str, destination);
-				history.any_output = true;
+			if constexpr (Policy::render) {
+				auto event = make_event(event_type::new_directory, check_mode, destination);
+				event.size = qpl::signed_cast(source.file_size_recursive());
+				events::emit(std::move(event));
 			}
-			if (!state.check_mode) {
+			if constexpr (Policy::apply) {
 				destination.ensure_branches_exist();
 			}
 		}
-		history.checked.insert(destination);
+		check();
 		return;
 	}
-	history.checked.insert(destination);
-
-	if (destination.exists()) {
-		bool equals;
-		if (state.quick_mode) {
-			equals = source.file_equals_no_read(destination);
-		}
-		else {
-			equals = source.file_equals(destination);
-		}
-		if (!equals) {
-			auto fs1 = source.file_size();
-			auto fs2 = destination.file_size();
+	check();
+	history.scanned_bytes += entry.source_stat.size;
+	++history.scanned_files;
+	progress::scanned(entry.source_stat.size);
 
-			auto time1 = source.last_write_time();
-			auto time2 = destination.last_write_time();
+	if (entry.destination_stat.has_value()) {
+		auto comparison = compare_files(entry, state.detection, index);
+		auto fs1 = comparison.source_size;
+		auto fs2 = comparison.destination_size;
+		auto time1 = comparison.source_time;
+		auto time2 = comparison.destination_time;
 
-			if (state.find_collisions) {
-				auto overwrites_newer = time2.time_since_epoch().count() > time1.time_since_epoch().count();
+		//every overwrite of an existing destination is kept in the snapshot first, not only the collisions.
+		auto overwrite = [&]() {
+			if (state.snapshot) {
+				snapshot::preserve(history.root, destination.string(), state.staged);
+			}
+			copy_file(source, destination, entry.source_stat.size, state, history);
+		};
+		auto sync_time = [&]() {
+			history.move_changes = true;
+			if constexpr (Policy::render) {
+				auto event = make_event(event_type::modified_metadata, check_mode, destination);
+				event.time1 = time1;
+				event.time2 = time2;
+				events::emit(std::move(event));
+			}
+			if constexpr (Policy::apply) {
+				sync_metadata(source, destination, time1);
+			}
+		};
 
-				bool different_time_but_same_data = overwrites_newer && source.file_content_equals(destination);
+		//a destination that is newer than its source is reported whether only its time or also its data is lost.
+		auto report_overwrite = [&](bool same_data) {
+			auto str = qpl::to_string(qpl::str_lspaced(time_diff_string(time1, time2, true), 42), " --- ", destination);
+			if (same_data) {
+				history.time_overwrites.push_back(str);
+			}
+			else {
+				history.data_overwrites.push_back(str);
+			}
+			++info::total_change_sum;
 
-				if (overwrites_newer) {
-					auto str = qpl::to_string(qpl::str_lspaced(time_diff_string(time1, time2, true), 42), " --- ", destination);
+			if constexpr (Policy::render) {
+				auto event = make_event(same_data ? event_type::time_overwrite : event_type::data_overwrite, check_mode, destination);
+				event.time1 = time1;
+				event.time2 = time2;
+				events::emit(std::move(event));
+			}
+		};
 
-					if (different_time_but_same_data) {
-						history.time_overwrites.push_back(str);
-						++info::total_change_sum;
-					}
-					else {
-						history.data_overwrites.push_back(str);
-						++info::total_change_sum;
-					}
+		if (comparison.equals && !comparison.same_time()) {
+			if constexpr (Policy::collisions) {
+				if (comparison.destination_newer()) {
+					report_overwrite(true);
+				}
+			}
+			sync_time();
+		}
+		else if (!comparison.equals) {
+			if constexpr (Policy::collisions) {
+				if (comparison.destination_newer()) {
+					report_overwrite(comparison.content(source, destination, index));
 				}
 			}
 
-			if (fs1 != fs2) {
+			if (!comparison.same_size()) {
 				history.move_changes = true;
-				auto diff = qpl::signed_cast(fs1) - qpl::signed_cast(fs2);
-				if (state.print) {
-					if (!history.any_output) qpl::println();
-
-					auto word = state.check_mode ? "[*]MODIFY" : "MODIFIED";
-					auto str = qpl::to_string(qpl::str_lspaced(qpl::to_string(word, diff > 0 ? " + " : " - ", qpl::memory_size_string(qpl::abs(diff))), info::print_space));
-					qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, str, destination);
-					history.any_output = true;
+				if constexpr (Policy::render) {
+					auto event = make_event(event_type::modified, check_mode, destination);
+					event.size = qpl::signed_cast(fs1) - qpl::signed_cast(fs2);
+					events::emit(std::move(event));
 				}
 
-				if (!state.check_mode) {
-					source.copy_overwrite(destination);
+				if constexpr (Policy::apply) {
+					overwrite();
 				}
 			}
-			else if (time1 != time2) {
+			//the stat tier never reads content, a different time there is copied like any other change.
+			else if (!comparison.same_time() && state.detection != detection::stat && comparison.content(source, destination, index)) {
+				sync_time();
+			}
+			else if (!comparison.same_time()) {
 				history.move_changes = true;
-				if (state.print) {
-					if (!history.any_output) qpl::println();
-					auto diff_str = time_diff_string(time1, time2, false);
-
-					auto word = state.check_mode ? "[*]MODIFY TIME" : "MODIFIED TIME";
-					auto str = qpl::to_string(word, ' ', diff_str);
-					qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, qpl::str_lspaced(str, info::print_space), destination);
-					history.any_output = true;
+				if constexpr (Policy::render) {
+					auto event = make_event(event_type::modified_time, check_mode, destination);
+					event.time1 = time1;
+					event.time2 = time2;
+					events::emit(std::move(event));
 				}
-				if (!state.check_mode) {
-					source.copy_overwrite(destination);
+				if constexpr (Policy::apply) {
+					overwrite();
 				}
 			}
 			else {
 				history.move_changes = true;
-				if (state.print) {
-					if (!history.any_output) qpl::println();
-
-					auto word = state.check_mode ? "[*]MODIFY [BYTES CHANGED] " : "MODIFIED [BYTES CHANGED] ";
-					qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, qpl::str_lspaced(word, info::print_space), destination);
-					history.any_output = true;
+				if constexpr (Policy::render) {
+					events::emit(make_event(event_type::modified_bytes, check_mode, destination));
 				}
-				if (!state.check_mode) {
-					source.copy_overwrite(destination);
+				if constexpr (Policy::apply) {
+					overwrite();
 				}
 			}
 		}
+		comparison_cache::store(destination.string(), comparison);
 	}
 	else {
 		history.move_changes = true;
-		if (state.print) {
-			if (!history.any_output) qpl::println();
-			auto word = state.check_mode ? "[*]NEW   " : "ADDED  ";
-			auto str = qpl::str_lspaced(qpl::to_string(word, " + ", qpl::memory_size_string(source.file_size_recursive())), info::print_space);
-			qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_green, str, destination);
-			history.any_output = true;
-		}
-		if (!state.check_mode) {
-			source.copy(destination);
+		if constexpr (Policy::render) {
+			auto event = make_event(event_type::added, check_mode, destination);
+			event.size = qpl::signed_cast(entry.source_stat.size);
+			events::emit(std::move(event));
 		}
-	}
-}
-
-void clear_path(const qpl::filesys::path& path, const state& state, history_status& history) {
-	if (history.find_ignored_root(path)) {
-		if (print_ignore && history.find_ignored(path)) {
-			if (state.print) {
-				if (!history.any_output) qpl::println();
-				auto word = state.check_mode ? "[*]IGNORED" : "IGNORED";
-				qpl::println(qpl::str_lspaced(word, info::print_space), path);
-				history.any_output = true;
+		if constexpr (Policy::apply) {
+			if (state.staged) {
+				copy_file(source, destination, entry.source_stat.size, state, history);
+			}
+			else {
+				throttle::io(entry.source_stat.size);
+				if (chunked_copy::eligible(entry.source_stat.size)) {
+					chunked_copy::copy_overwrite(source, destination, entry.source_stat.size);
+				}
+				else {
+					source.copy(destination);
+					progress::copied(entry.source_stat.size);
+				}
 			}
-		}
-		return;
-	}
-
-	path.update();
-	if (!path.exists()) {
-		return;
-	}
-
-	if (!history.find_checked(path.ensured_directory_backslash())) {
-		history.move_changes = true;
-		history.removes.push_back(path);
-		++info::total_change_sum;
-		if (state.print) {
-			if (!history.any_output) qpl::println();
-
-			auto word = state.check_mode ? "[*]REMOVE" : "REMOVED";
-			auto str = qpl::str_lspaced(qpl::to_string(word, " - ", qpl::memory_size_string(path.file_size_recursive())), info::print_space);
-			qpl::println(state.check_mode ? qpl::color::white : qpl::color::light_red, str, path);
-			history.any_output = true;
-		}
-		if (!state.check_mode) {
-			qpl::filesys::remove(path.ensured_directory_backslash());
 		}
 	}
 }
 
-void clear_paths(const qpl::filesys::path& path, const state& state, history_status& history) {
-	if (path.is_directory()) {
-		auto paths = path.list_current_directory_tree_include_self();
-		for (auto& path : paths) {
-			clear_path(path, state, history);
-		}
-	}
-	else {
-		clear_path(path, state, history);
-	}
-}
+//removals found while streaming are applied in batches of this size, so the pending list stays bounded.
+constexpr qpl::size streaming_removal_batch = 256u;
 
 void find_removables(const qpl::filesys::path& path, const state& state, history_status& history) {
+	std::vector<removal> removals;
+
 	auto paths = path.list_current_directory();
 	for (auto& path : paths) {
 		path.ensure_directory_backslash();
-		if (path.is_file() && history.find_checked(path)) {
+		if (!can_touch(path, state.action == action::push)) {
+			if (state.print && print_ignore) {
+				events::emit(make_event(event_type::ignored, state.check_mode, path));
+			}
 			continue;
 		}
-		if (can_touch(path, state.action == action::push)) {
-			clear_paths(path, state, history);
-		}
-		else {
-			if (state.print && print_ignore) {
-				auto word = state.check_mode ? "[*]IGNORED " : "IGNORED ";
-				qpl::println(qpl::str_lspaced(word, info::print_space), path);
+		if (history.find_ignored_root(path)) {
+			if (state.print && print_ignore && history.find_ignored(path)) {
+				events::emit(make_event(event_type::ignored, state.check_mode, path));
 			}
+			continue;
 		}
+		if (!history.find_checked(path)) {
+			removals.push_back({ path });
+		}
+		else if (path.is_directory()) {
+			plan_removals(path, history, removals);
+		}
+	}
+	apply_removals(removals, state, history);
+}
+
+//(source, destination) directories of a move from the working directory at path.
+std::pair<std::string, std::string> move_roots(const qpl::filesys::path& path, action action) {
+	auto branch = path.branch_size() - 1;
+	if (action == action::pull) {
+		auto source = path.ensured_directory_backslash().with_branch(branch, "git");
+		auto destination = path.ensured_directory_backslash().with_branch(branch, path.get_directory_name());
+		return std::make_pair(source.ensured_directory_backslash().string(), destination.string());
 	}
+	auto destination = path.ensured_directory_backslash().with_branch(branch, "git");
+	return std::make_pair(path.ensured_directory_backslash().string(), destination.string());
 }
 
-void move(const qpl::filesys::path& path, const state& state, history_status& history) {
+//source directories with their listing, as the walk reads them.
+using directory_follower = std::function<void(const std::string&, const std::vector<entry_stat>&)>;
+
+//directory_pruning that first hands every listed source directory to follow, so other targets such as the backup
+//mirrors are served by the same walk instead of listing the source again.
+struct following_pruning {
+	directory_pruning& pruning;
+	const directory_follower& follow;
+
+	bool enter(const std::string& source_directory, const std::string& destination_directory, const std::vector<entry_stat>& source_entries, const std::unordered_map<std::string, entry_stat>& destination_entries) {
+		if (this->follow) {
+			this->follow(source_directory, source_entries);
+		}
+		return this->pruning.enter(source_directory, destination_directory, source_entries, destination_entries);
+	}
+	void leave(const std::string& source_directory) {
+		this->pruning.leave(source_directory);
+	}
+};
+
+void move(const qpl::filesys::path& path, const state& state, history_status& history, const directory_follower& follow = nullptr) {
 	if (!path.exists()) {
-		qpl::println("MOVE : ", path, " doesn't exist.");
+		events::error(qpl::to_string("MOVE : ", path, " doesn't exist."));
 		return;
 	}
 	if (!is_valid_working_directory(path)) {
-		qpl::println("MOVE : ", path, " is not a valid working directory with a solution file.");
+		events::error(qpl::to_string("MOVE : ", path, " is not a valid working directory with a solution file."));
 		return;
 	}
 	if (!has_git_directory(path.get_parent_branch())) {
-		qpl::println("MOVE : ", path, " couldn't find a git directory.");
+		events::error(qpl::to_string("MOVE : ", path, " couldn't find a git directory."));
 		return;
 	}
 
 	bool target_is_git = state.action == action::push;
 	bool target_is_work = state.action == action::pull;
-	auto branch = path.branch_size() - 1;
-	std::string target_branch_name;
 
-	qpl::filesys::path target_path;
-	if (state.action == action::pull) {
-		target_branch_name = path.get_directory_name();
-		target_path = path.ensured_directory_backslash().with_branch(branch, "git");
-	}
-	else {
-		target_branch_name = "git";
-		target_path = path;
-	}
 	history.checked.clear();
+	history.staged_copies.clear();
 	history.move_changes = false;
+	history.apply_failed = false;
+	history.scanned_bytes = 0u;
+	history.scanned_files = 0u;
+	history.root = path.get_parent_branch().string();
 
-	auto paths = target_path.list_current_directory();
-	for (auto& path : paths) {
-		if (can_touch(path, target_is_work)) {
-			if (path.is_directory()) {
-				auto dir_paths = path.list_current_directory_tree_include_self();
-				for (auto& path : dir_paths) {
-
-					auto destination = path.with_branch(branch, target_branch_name);
-					if (path.is_directory()) {
-						destination.ensure_backslash();
-					}
-					perform_move(path, destination, state, history);
+	auto [source_root, destination_root] = move_roots(path, state.action);
+	//stat'ed and parsed once per pass, the workers only read it.
+	auto index = git_index::load(git_index::normalized(history.root) + "git/");
+
+	std::vector<removal> removals;
+	auto removed = [&](const std::string& path, const entry_stat&) {
+		if (!state.streaming || history.find_ignored_root(path)) {
+			return;
+		}
+		removals.push_back({ path });
+		if (removals.size() >= streaming_removal_batch) {
+			apply_removals(removals, state, history);
+			removals.clear();
+		}
+	};
+	directory_pruning summaries(state, history);
+	following_pruning pruning{ summaries, follow };
+	auto source_entries = read_directory(source_root);
+	auto destination_entries = read_directory(destination_root);
+	if (follow) {
+		follow(source_root, source_entries);
+	}
+	with_move_policy(state, [&]<typename Policy>(Policy) {
+		auto perform = [&](const move_entry& entry) {
+			perform_move<Policy>(entry, state, history, index.get());
+		};
+		for (auto& entry : source_entries) {
+			auto suffix = entry.directory ? entry.name + '/' : entry.name;
+
+			move_entry item;
+			item.source = source_root + suffix;
+			item.destination = destination_root + suffix;
+			item.source_stat = entry;
+			for (auto& destination : destination_entries) {
+				if (destination.name == entry.name) {
+					item.destination_stat = destination;
+					break;
+				}
+			}
+
+			if (can_touch(item.source, target_is_work)) {
+				perform_move<Policy>(item, state, history, index.get());
+				if (entry.directory) {
+					bool destination_exists = item.destination_stat.has_value() && item.destination_stat->directory;
+					walk_mirrored(source_root + suffix, destination_root + suffix, destination_exists, perform, removed, pruning);
 				}
 			}
 			else {
-				auto destination = path.with_branch(branch, target_branch_name).ensured_directory_backslash();
-				if (path.is_directory()) {
-					destination.ensure_backslash();
+				if (state.print && print_ignore) {
+					events::emit(make_event(event_type::ignored, state.check_mode, item.source));
 				}
-				perform_move(path, destination, state, history);
 			}
 		}
-		else {
-			if (state.print && print_ignore) {
-				auto word = state.check_mode ? "[*]IGNORED " : "IGNORED ";
-				qpl::println(qpl::str_lspaced(word, info::print_space), path);
+	});
+
+	alloc_stats::scope apply_scope(alloc_stats::phase::apply);
+	if (!state.check_mode && state.staged) {
+		//directories whose copies weren't all applied must not be pruned by the next run.
+		if (!apply_staged_copies(std::filesystem::path(path.get_parent_branch().string()), history)) {
+			history.apply_failed = true;
+			for (auto& [source, destination] : history.staged_copies) {
+				summary_cache::forget(std::filesystem::path(source).parent_path().generic_string() + '/');
 			}
+			history.staged_copies.clear();
 		}
 	}
 
-	auto git_path = path.ensured_directory_backslash().with_branch(branch, target_branch_name);
-	find_removables(git_path, state, history);
+	if (state.streaming) {
+		for (auto& entry : destination_entries) {
+			auto destination = qpl::filesys::path(destination_root + (entry.directory ? entry.name + '/' : entry.name));
+			if (!can_touch(destination, state.action == action::push)) {
+				continue;
+			}
+			bool matched = false;
+			for (auto& source : source_entries) {
+				if (source.name == entry.name) {
+					matched = can_touch(qpl::filesys::path(source_root + (source.directory ? source.name + '/' : source.name)), target_is_work);
+					break;
+				}
+			}
+			if (!matched) {
+				removed(destination, entry);
+			}
+		}
+		apply_removals(removals, state, history);
+	}
+	else {
+		find_removables(destination_root, state, history);
+	}
 }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <thread>
+#include "throttle.hpp"
+
+qpl::size default_thread_count() {
+	return qpl::max(qpl::size{ 1u }, qpl::size{ std::thread::hardware_concurrency() });
+}
+
+//runs function(index) for every index in [0, count) on up to thread_count threads, including the calling one.
+//background threads don't fan out, their work stays on the one throttled thread.
+template<typename F>
+void parallel_for(qpl::size count, F&& function, qpl::size thread_count = default_thread_count()) {
+	if (!count) {
+		return;
+	}
+	if (throttle::background_thread) {
+		thread_count = 1u;
+	}
+	std::atomic_size_t next = 0u;
+	auto worker = [&]() {
+		while (true) {
+			auto index = next++;
+			if (index >= count) {
+				break;
+			}
+			function(index);
+		}
+	};
+
+	thread_count = qpl::min(thread_count, count);
+	std::vector<std::thread> threads;
+	for (qpl::size i = 1u; i < thread_count; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <charconv>
+#include <memory>
+#include <string_view>
+
+struct git_entry {
+	char kind = '1';
+	char staged = '.';
+	char unstaged = '.';
+	std::string_view path;
+	std::string_view original_path;
+};
+
+//parsed "git status --porcelain=v2 --branch -z". all views point into the shared output buffer,
+//so copies of a git_status stay valid and parsing allocates nothing but the entry list.
+struct git_status {
+	std::shared_ptr<const std::string> output;
+	std::string_view oid;
+	std::string_view head;
+	std::string_view upstream;
+	qpl::size ahead = 0u;
+	qpl::size behind = 0u;
+	qpl::size staged = 0u;
+	qpl::size unstaged = 0u;
+	qpl::size untracked = 0u;
+	qpl::size unmerged = 0u;
+	std::vector<git_entry> entries;
+	bool valid = false;
+
+	bool has_upstream() const {
+		return !this->upstream.empty();
+	}
+	bool dirty() const {
+		return this->staged || this->unstaged || this->untracked || this->unmerged;
+	}
+	void reset() {
+		*this = git_status{};
+	}
+
+	//returns what is left after skipping count space separated fields.
+	static std::string_view skip_fields(std::string_view record, qpl::size count) {
+		for (qpl::size i = 0u; i < count; ++i) {
+			auto space = record.find(' ');
+			if (space == std::string_view::npos) {
+				return {};
+			}
+			record.remove_prefix(space + 1);
+		}
+		return record;
+	}
+	static qpl::size parse_count(std::string_view string) {
+		qpl::size value = 0u;
+		std::from_chars(string.data(), string.data() + string.size(), value);
+		return value;
+	}
+
+	void parse_header(std::string_view record) {
+		record.remove_prefix(2u);
+		auto space = record.find(' ');
+		if (space == std::string_view::npos) {
+			return;
+		}
+		auto key = record.substr(0u, space);
+		auto value = record.substr(space + 1);
+		if (key == "branch.oid") {
+			this->oid = value;
+		}
+		else if (key == "branch.head") {
+			this->head = value;
+		}
+		else if (key == "branch.upstream") {
+			this->upstream = value;
+		}
+		else if (key == "branch.ab") {
+			auto minus = value.find(" -");
+			if (value.size() > 1u && value.front() == '+' && minus != std::string_view::npos) {
+				this->ahead = parse_count(value.substr(1u, minus - 1u));
+				this->behind = parse_count(value.substr(minus + 2u));
+			}
+		}
+	}
+	void add_entry(char kind, std::string_view record, qpl::size skip) {
+		git_entry entry;
+		entry.kind = kind;
+		if (record.size() > 3u) {
+			entry.staged = record[2];
+			entry.unstaged = record[3];
+		}
+		entry.path = skip_fields(record, skip);
+		if (kind == 'u') {
+			++this->unmerged;
+		}
+		else {
+			this->staged += entry.staged != '.';
+			this->unstaged += entry.unstaged != '.';
+		}
+		this->entries.push_back(entry);
+	}
+
+	bool parse(std::string data) {
+		this->reset();
+		this->output = std::make_shared<const std::string>(std::move(data));
+		std::string_view rest = *this->output;
+
+		auto next_record = [&]() {
+			auto end = rest.find('\0');
+			auto record = rest.substr(0u, end);
+			rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+			return record;
+		};
+		while (!rest.empty()) {
+			auto record = next_record();
+			if (record.size() < 2u) {
+				continue;
+			}
+			switch (record.front()) {
+			case '#':
+				this->parse_header(record);
+				break;
+			case '1':
+				this->add_entry('1', record, 8u);
+				break;
+			case '2':
+				this->add_entry('2', record, 9u);
+				this->entries.back().original_path = next_record();
+				break;
+			case 'u':
+				this->add_entry('u', record, 10u);
+				break;
+			case '?': {
+				git_entry entry;
+				entry.kind = '?';
+				entry.unstaged = '?';
+				entry.path = record.substr(2u);
+				++this->untracked;
+				this->entries.push_back(entry);
+			} break;
+			default:
+				break;
+			}
+		}
+		this->valid = !this->head.empty();
+		return this->valid;
+	}
+
+	std::string summary() const {
+		std::ostringstream stream;
+		stream << "on branch " << this->head;
+		if (this->has_upstream()) {
+			stream << " -> " << this->upstream << ", ahead " << this->ahead << ", behind " << this->behind;
+		}
+		if (this->dirty()) {
+			stream << ", " << this->staged << " staged, " << this->unstaged << " unstaged, " << this->untracked << " untracked";
+			if (this->unmerged) {
+				stream << ", " << this->unmerged << " unmerged";
+			}
+		}
+		return stream.str();
+	}
+};
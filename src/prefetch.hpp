@@ -0,0 +1,122 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "throttle.hpp"
+
+//fetches every repository in the background at startup and again while the prompt is idle.
+//the last fetch time is the write time of .git/FETCH_HEAD, so it also survives restarts.
+namespace prefetch {
+	constexpr qpl::size default_window = 120u;
+	constexpr auto idle_interval = std::chrono::seconds(30);
+
+	std::atomic_bool idle = false;
+	std::mutex locks_mutex;
+	std::unordered_map<std::string, std::unique_ptr<std::mutex>> repository_locks;
+
+	std::string key(std::string path) {
+		std::replace(path.begin(), path.end(), '\\', '/');
+		if (path.empty() || path.back() != '/') {
+			path.push_back('/');
+		}
+		return path;
+	}
+
+	//held by anything that runs git in that repository, so a background fetch never races a foreground command.
+	std::mutex& repository_lock(const std::string& path) {
+		std::lock_guard lock(locks_mutex);
+		auto& result = repository_locks[key(path)];
+		if (!result) {
+			result = std::make_unique<std::mutex>();
+		}
+		return *result;
+	}
+
+	bool fresh(const std::string& path, qpl::size window) {
+		if (!window) {
+			return false;
+		}
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(std::filesystem::path(key(path) + ".git/FETCH_HEAD"), error);
+		if (error) {
+			return false;
+		}
+		auto age = std::filesystem::file_time_type::clock::now() - time;
+		return age < std::chrono::seconds(window);
+	}
+
+	bool fetch(const std::string& path) {
+#if defined(_WIN32)
+		auto command = qpl::to_string("git -C \"", path, "\" fetch --quiet > NUL 2>&1");
+#else
+		auto command = qpl::to_string("git -C \"", path, "\" fetch --quiet > /dev/null 2>&1");
+#endif
+		return std::system(command.c_str()) == 0;
+	}
+
+	struct fetcher {
+		std::vector<std::string> paths;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::atomic_bool running = false;
+		std::atomic<qpl::size> window = default_window;
+
+		~fetcher() {
+			this->stop();
+		}
+
+		//startup fetches run regardless of the prompt, later rounds only while it is idle.
+		void fetch_stale(bool startup) {
+			for (auto& path : this->paths) {
+				if (!this->running || (!startup && !idle)) {
+					return;
+				}
+				if (fresh(path, this->window)) {
+					continue;
+				}
+				std::unique_lock lock(repository_lock(path), std::try_to_lock);
+				if (lock.owns_lock()) {
+					fetch(path);
+				}
+			}
+		}
+		void start(std::vector<std::string> paths) {
+			this->stop();
+			this->paths = std::move(paths);
+			this->running = true;
+			this->thread = std::thread([&]() {
+				throttle::enter_background();
+				this->fetch_stale(true);
+				while (this->running) {
+					{
+						std::unique_lock lock(this->mutex);
+						this->condition.wait_for(lock, idle_interval, [&]() {
+							return !this->running;
+						});
+					}
+					if (this->running && idle) {
+						this->fetch_stale(false);
+					}
+				}
+			});
+		}
+		void stop() {
+			if (!this->running) {
+				return;
+			}
+			{
+				std::lock_guard lock(this->mutex);
+				this->running = false;
+			}
+			this->condition.notify_all();
+			this->thread.join();
+		}
+	};
+
+	fetcher background;
+}
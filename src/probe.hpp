@@ -0,0 +1,64 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "database.hpp"
+
+namespace probe {
+	//a path that doesn't answer within this time counts as missing, e.g. an unreachable network share.
+	constexpr auto timeout = std::chrono::milliseconds(1500);
+
+	//"last" -> name of the location that matched on the previous start.
+	local_database database("location");
+
+	struct results {
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::vector<char> exists;
+		qpl::size done = 0u;
+	};
+
+	//checks all paths at once. probes are detached, so a hanging stat only costs the timeout
+	//and finishes in the background; the shared results keep its slot alive.
+	std::vector<bool> exists(const std::vector<std::string>& paths) {
+		auto shared = std::make_shared<results>();
+		shared->exists.resize(paths.size(), 0);
+		for (qpl::size i = 0u; i < paths.size(); ++i) {
+			std::thread([shared, i, path = paths[i]]() {
+				std::error_code error;
+				bool found = std::filesystem::exists(std::filesystem::path(path), error);
+				{
+					std::lock_guard lock(shared->mutex);
+					shared->exists[i] = found;
+					++shared->done;
+				}
+				shared->condition.notify_all();
+			}).detach();
+		}
+
+		std::vector<bool> result(paths.size());
+		std::unique_lock lock(shared->mutex);
+		shared->condition.wait_for(lock, timeout, [&]() {
+			return shared->done == paths.size();
+		});
+		for (qpl::size i = 0u; i < paths.size(); ++i) {
+			result[i] = shared->exists[i];
+		}
+		return result;
+	}
+
+	std::optional<std::string> last_location() {
+		auto fields = database.find("last");
+		if (!fields.has_value() || fields->empty()) {
+			return std::nullopt;
+		}
+		return fields->front();
+	}
+	void set_last_location(const std::string& name) {
+		database.set("last", { name });
+		database.save();
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "events.hpp"
+
+//live status line for long moves. workers only bump relaxed atomics, a separate thread redraws the line
+//at a fixed rate while holding the event stream's console lock, so it never interleaves with event output.
+namespace progress {
+	constexpr auto redraw_interval = std::chrono::milliseconds(250);
+	//runs shorter than this never show a line.
+	constexpr auto show_delay = std::chrono::milliseconds(750);
+	constexpr qpl::size max_width = 118u;
+
+	std::atomic<qpl::u64> files_scanned = 0u;
+	std::atomic<qpl::u64> bytes_scanned = 0u;
+	std::atomic<qpl::u64> bytes_compared = 0u;
+	std::atomic<qpl::u64> bytes_copied = 0u;
+	std::atomic_bool active = false;
+
+	std::mutex mutex;
+	std::string directory;
+	qpl::u64 expected_files = 0u;
+	qpl::u64 expected_bytes = 0u;
+	std::chrono::steady_clock::time_point begin_time;
+
+	void scanned(qpl::u64 bytes) {
+		files_scanned.fetch_add(1u, std::memory_order_relaxed);
+		bytes_scanned.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	void compared(qpl::u64 bytes) {
+		bytes_compared.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	void copied(qpl::u64 bytes) {
+		bytes_copied.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	//expected sizes come from the last recorded run of the directory, 0 = unknown.
+	void begin(const std::string& path, qpl::u64 files, qpl::u64 bytes) {
+		std::lock_guard lock(mutex);
+		directory = path;
+		expected_files = files;
+		expected_bytes = bytes;
+		begin_time = std::chrono::steady_clock::now();
+		files_scanned = 0u;
+		bytes_scanned = 0u;
+		bytes_compared = 0u;
+		bytes_copied = 0u;
+		active = true;
+	}
+	void end() {
+		active = false;
+		events::stream.clear_status();
+	}
+
+	struct renderer {
+		std::thread thread;
+		std::atomic_bool running = false;
+		qpl::u64 last_bytes = 0u;
+		std::chrono::steady_clock::time_point last_time;
+		qpl::f64 rate = 0.0;
+
+		~renderer() {
+			this->stop();
+		}
+
+		std::string line() {
+			std::lock_guard lock(mutex);
+			auto now = std::chrono::steady_clock::now();
+			if (now - begin_time < show_delay) {
+				return {};
+			}
+			if (this->last_time < begin_time) {
+				this->last_time = begin_time;
+				this->last_bytes = 0u;
+				this->rate = 0.0;
+			}
+			auto bytes = bytes_compared.load() + bytes_copied.load();
+			auto seconds = std::chrono::duration<qpl::f64>(now - this->last_time).count();
+			if (bytes < this->last_bytes) {
+				this->last_bytes = 0u;
+			}
+			if (seconds > 0.0) {
+				auto current = (bytes - this->last_bytes) / seconds;
+				this->rate = this->rate == 0.0 ? current : this->rate * 0.7 + current * 0.3;
+			}
+			this->last_bytes = bytes;
+			this->last_time = now;
+
+			std::ostringstream stream;
+			stream << "[ " << files_scanned.load();
+			if (expected_files) {
+				stream << " / ~" << expected_files;
+			}
+			stream << " files | compared " << qpl::memory_size_string(bytes_compared.load());
+			stream << " | copied " << qpl::memory_size_string(bytes_copied.load());
+			stream << " | " << qpl::memory_size_string(static_cast<qpl::u64>(this->rate)) << "/s";
+
+			auto scanned = bytes_scanned.load();
+			auto elapsed = std::chrono::duration<qpl::f64>(now - begin_time).count();
+			if (expected_bytes && scanned && scanned < expected_bytes) {
+				auto eta = elapsed * (expected_bytes - scanned) / scanned;
+				stream << " | ETA " << qpl::time(static_cast<qpl::i64>(eta * 1e9)).string_short();
+			}
+			stream << " ] " << directory;
+
+			auto result = stream.str();
+			if (result.length() > max_width) {
+				result = result.substr(0u, max_width - 3u) + "...";
+			}
+			return result;
+		}
+
+		void start() {
+			if (this->running) {
+				return;
+			}
+			this->running = true;
+			this->thread = std::thread([&]() {
+				while (this->running) {
+					std::this_thread::sleep_for(redraw_interval);
+					if (active && events::console()) {
+						auto line = this->line();
+						if (!line.empty()) {
+							events::stream.show_status(line, active);
+						}
+					}
+				}
+			});
+		}
+		void stop() {
+			if (!this->running) {
+				return;
+			}
+			this->running = false;
+			this->thread.join();
+		}
+	};
+
+	renderer display;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include "state.hpp"
+#include "info.hpp"
+#include "events.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+
+struct removal {
+	qpl::filesys::path path;
+	qpl::size bytes = 0u;
+	qpl::size entries = 0u;
+};
+
+void measure_removal(removal& removal) {
+	std::error_code error;
+	std::filesystem::path path(removal.path.string());
+	removal.entries = 1u;
+	if (!std::filesystem::is_directory(path, error)) {
+		removal.bytes = std::filesystem::file_size(path, error);
+		return;
+	}
+	for (auto it = std::filesystem::recursive_directory_iterator(path, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+		++removal.entries;
+		if (it->is_regular_file(error)) {
+			removal.bytes += it->file_size(error);
+		}
+	}
+}
+
+//an unchecked directory means the source has no such directory, so nothing below it was checked either.
+//the whole subtree collapses into one removal, only checked directories are descended into.
+void plan_removals(const qpl::filesys::path& directory, history_status& history, std::vector<removal>& removals) {
+	auto paths = directory.list_current_directory();
+	for (auto& path : paths) {
+		path.ensure_directory_backslash();
+		if (history.find_ignored_root(path)) {
+			continue;
+		}
+		if (!history.find_checked(path)) {
+			removals.push_back({ path });
+		}
+		else if (path.is_directory()) {
+			plan_removals(path, history, removals);
+		}
+	}
+}
+
+void apply_removals(std::vector<removal>& removals, const state& state, history_status& history) {
+	if (removals.empty()) {
+		return;
+	}
+	//the collision check counts every removed entry of a subtree for the confirmation.
+	if (state.print || state.find_collisions) {
+		parallel_for(removals.size(), [&](qpl::size index) {
+			measure_removal(removals[index]);
+		});
+	}
+
+	for (auto& removal : removals) {
+		history.move_changes = true;
+		history.removes.push_back(removal.path);
+		info::total_change_sum += qpl::max(removal.entries, qpl::size{ 1u });
+		if (state.print) {
+			events::emit(make_event(event_type::remove_collision, state.check_mode, removal.path));
+			auto event = make_event(event_type::removed, state.check_mode, removal.path);
+			event.size = qpl::signed_cast(removal.bytes);
+			event.count = removal.entries;
+			events::emit(std::move(event));
+		}
+	}
+
+	if (!state.check_mode) {
+		if (state.snapshot) {
+			for (auto& removal : removals) {
+				snapshot::preserve(history.root, removal.path.string(), true);
+			}
+		}
+		parallel_for(removals.size(), [&](qpl::size index) {
+			throttle::io(0u);
+			std::error_code error;
+			std::filesystem::remove_all(std::filesystem::path(removals[index].path.string()), error);
+			if (error) {
+				events::error(qpl::to_string("REMOVE : couldn't remove ", removals[index].path, " : ", error.message()));
+			}
+		});
+	}
+}
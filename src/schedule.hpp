@@ -0,0 +1,138 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include "database.hpp"
+
+struct run_record {
+	qpl::i64 time = 0;
+	qpl::f64 scan_seconds = 0.0;
+	qpl::f64 git_seconds = 0.0;
+	qpl::u64 bytes = 0u;
+	qpl::u64 files = 0u;
+
+	qpl::f64 cost() const {
+		return this->scan_seconds + this->git_seconds;
+	}
+	std::string string() const {
+		return qpl::to_string(this->time, ';', this->scan_seconds, ';', this->git_seconds, ';', this->bytes, ';', this->files);
+	}
+	static std::optional<run_record> from_string(const std::string& string) {
+		auto split = qpl::split_string(string, ';');
+		if (split.size() != 4u && split.size() != 5u) {
+			return std::nullopt;
+		}
+		try {
+			run_record record;
+			record.time = std::stoll(split[0]);
+			record.scan_seconds = std::stod(split[1]);
+			record.git_seconds = std::stod(split[2]);
+			record.bytes = std::stoull(split[3]);
+			if (split.size() > 4u) {
+				record.files = std::stoull(split[4]);
+			}
+			return record;
+		}
+		catch (...) {
+			return std::nullopt;
+		}
+	}
+};
+
+namespace run_history {
+	//directory -> the most recent run records, oldest first.
+	local_database database("history");
+	constexpr qpl::size max_records = 20u;
+
+	std::vector<run_record> records(const std::string& path) {
+		std::vector<run_record> result;
+		auto fields = database.find(path);
+		if (!fields.has_value()) {
+			return result;
+		}
+		for (auto& field : fields.value()) {
+			auto record = run_record::from_string(field);
+			if (record.has_value()) {
+				result.push_back(record.value());
+			}
+		}
+		return result;
+	}
+	void add(const std::string& path, run_record record) {
+		auto fields = database.find(path).value_or(std::vector<std::string>{});
+		fields.push_back(record.string());
+		if (fields.size() > max_records) {
+			fields.erase(fields.begin(), fields.begin() + (fields.size() - max_records));
+		}
+		database.set(path, fields);
+	}
+	std::optional<qpl::f64> expected_cost(const std::string& path) {
+		auto list = records(path);
+		if (list.empty()) {
+			return std::nullopt;
+		}
+		qpl::f64 sum = 0.0;
+		for (auto& record : list) {
+			sum += record.cost();
+		}
+		return sum / list.size();
+	}
+	//"directory|push" / "directory|pull" -> files and bytes one move pass in that direction scanned last time.
+	//a command runs several passes (collision check, push, pull), the progress line estimates a single one.
+	local_database passes("passes");
+
+	void record_pass(const std::string& path, const std::string& action, qpl::u64 files, qpl::u64 bytes) {
+		passes.set(path + '|' + action, { std::to_string(files), std::to_string(bytes) });
+	}
+	std::pair<qpl::u64, qpl::u64> expected_pass(const std::string& path, const std::string& action) {
+		auto fields = passes.find(path + '|' + action);
+		if (!fields.has_value() || fields->size() != 2u) {
+			return {};
+		}
+		try {
+			return std::make_pair(std::stoull(fields->at(0u)), std::stoull(fields->at(1u)));
+		}
+		catch (...) {
+			return {};
+		}
+	}
+	void save() {
+		database.save();
+		passes.save();
+	}
+
+	std::string seconds_string(qpl::f64 seconds) {
+		return qpl::time(static_cast<qpl::i64>(seconds * 1e9)).string_short();
+	}
+
+	void print_report(const std::vector<std::string>& paths) {
+		qpl::size length = 0u;
+		for (auto& path : paths) {
+			length = qpl::max(length, path.length());
+		}
+		qpl::println();
+		for (auto& path : paths) {
+			auto list = records(path);
+			if (list.empty()) {
+				qpl::println(qpl::appended_to_string_to_fit(path, ". ", length + 2), qpl::color::gray, "no runs recorded.");
+				continue;
+			}
+			qpl::f64 scan = 0.0;
+			qpl::f64 git = 0.0;
+			for (auto& record : list) {
+				scan += record.scan_seconds;
+				git += record.git_seconds;
+			}
+			scan /= list.size();
+			git /= list.size();
+
+			auto& last = list.back();
+			auto average = scan + git;
+			auto trend = average > 0.0 ? (last.cost() - average) / average * 100.0 : 0.0;
+			auto trend_color = trend > 10.0 ? qpl::color::light_red : (trend < -10.0 ? qpl::color::light_green : qpl::color::gray);
+
+			qpl::print(qpl::appended_to_string_to_fit(path, ". ", length + 2));
+			qpl::print(list.size(), " runs, scan ", seconds_string(scan), ", git ", seconds_string(git), ", ", qpl::memory_size_string(last.bytes), " | last ", seconds_string(last.cost()), ' ');
+			qpl::println(trend_color, qpl::to_string(trend >= 0.0 ? "+" : "", static_cast<qpl::i64>(trend), '%'));
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+using sha1_digest = std::array<qpl::u8, 20u>;
+
+//plain SHA-1, only used to produce git blob ids.
+struct sha1 {
+	std::array<qpl::u32, 5u> state = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+	std::array<qpl::u8, 64u> block{};
+	qpl::size block_size = 0u;
+	qpl::u64 length = 0u;
+
+	static constexpr qpl::u32 rotate(qpl::u32 x, int n) {
+		return (x << n) | (x >> (32 - n));
+	}
+	void transform() {
+		qpl::u32 w[80];
+		for (int i = 0; i < 16; ++i) {
+			w[i] = (qpl::u32{ this->block[i * 4] } << 24) | (qpl::u32{ this->block[i * 4 + 1] } << 16) | (qpl::u32{ this->block[i * 4 + 2] } << 8) | qpl::u32{ this->block[i * 4 + 3] };
+		}
+		for (int i = 16; i < 80; ++i) {
+			w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		}
+		auto a = this->state[0];
+		auto b = this->state[1];
+		auto c = this->state[2];
+		auto d = this->state[3];
+		auto e = this->state[4];
+		for (int i = 0; i < 80; ++i) {
+			qpl::u32 f, k;
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999u;
+			}
+			else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1u;
+			}
+			else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDCu;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6u;
+			}
+			auto temp = rotate(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rotate(b, 30);
+			b = a;
+			a = temp;
+		}
+		this->state[0] += a;
+		this->state[1] += b;
+		this->state[2] += c;
+		this->state[3] += d;
+		this->state[4] += e;
+	}
+	void update(const char* data, qpl::size size) {
+		this->length += size;
+		while (size) {
+			auto take = qpl::min(size, 64u - this->block_size);
+			std::memcpy(this->block.data() + this->block_size, data, take);
+			this->block_size += take;
+			data += take;
+			size -= take;
+			if (this->block_size == 64u) {
+				this->transform();
+				this->block_size = 0u;
+			}
+		}
+	}
+	sha1_digest finish() {
+		auto bits = this->length * 8u;
+		char padding = static_cast<char>(0x80);
+		this->update(&padding, 1u);
+		char zero = 0;
+		while (this->block_size != 56u) {
+			this->update(&zero, 1u);
+		}
+		char size[8];
+		for (int i = 0; i < 8; ++i) {
+			size[i] = static_cast<char>(bits >> (56 - i * 8));
+		}
+		this->update(size, 8u);
+
+		sha1_digest result;
+		for (qpl::size i = 0u; i < 20u; ++i) {
+			result[i] = static_cast<qpl::u8>(this->state[i / 4] >> (24 - (i % 4) * 8));
+		}
+		return result;
+	}
+};
+
+//the id git gives the file's content: sha1("blob <size>\0" + content).
+std::optional<sha1_digest> git_blob_id(const std::string& path) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return std::nullopt;
+	}
+	auto size = static_cast<qpl::u64>(file.tellg());
+	file.seekg(0);
+
+	sha1 hash;
+	auto header = "blob " + std::to_string(size);
+	hash.update(header.data(), header.size() + 1u);
+
+	std::vector<char> buffer(1u << 16);
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		hash.update(buffer.data(), static_cast<qpl::size>(file.gcount()));
+	}
+	return hash.finish();
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include "events.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+//keeps the files a sync is about to overwrite or remove in "<root>/.autogit_snapshots/<id>/", mirrored
+//relative to root. only those files are touched, so a snapshot costs as much as the change set.
+namespace snapshot {
+	constexpr qpl::size default_keep = 10u;
+
+	//id of the snapshot taken by the running command, set once per command.
+	std::string current_id;
+	std::mutex mutex;
+
+	std::string new_id() {
+		auto time = std::time(nullptr);
+		std::tm local{};
+#if defined(_WIN32)
+		localtime_s(&local, &time);
+#else
+		localtime_r(&time, &local);
+#endif
+		std::ostringstream stream;
+		stream << std::put_time(&local, "%Y-%m-%d_%H-%M-%S");
+		return stream.str();
+	}
+	std::filesystem::path directory(const std::filesystem::path& root) {
+		return root / ".autogit_snapshots";
+	}
+
+	//same volume as the tree, so a hardlink is possible. a file overwritten in place must not share its inode
+	//with the snapshot, then a reflink is tried and a plain copy is the fallback.
+	bool preserve_file(const std::filesystem::path& source, const std::filesystem::path& target, bool link) {
+		std::error_code error;
+		std::filesystem::create_directories(target.parent_path(), error);
+		if (link) {
+			std::filesystem::create_hard_link(source, target, error);
+			if (!error) {
+				return true;
+			}
+		}
+#if defined(__linux__)
+		auto in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+		if (in >= 0) {
+			auto out = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			bool cloned = out >= 0 && ::ioctl(out, FICLONE, in) == 0;
+			if (out >= 0) {
+				::close(out);
+			}
+			::close(in);
+			if (cloned) {
+				return true;
+			}
+		}
+#endif
+		error.clear();
+		std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing, error);
+		return !error;
+	}
+
+	//keeps path, a file or a whole subtree below root. link = the original is replaced or unlinked, never written in place.
+	void preserve(const std::string& root, const std::string& path, bool link) {
+		std::lock_guard lock(mutex);
+		if (current_id.empty()) {
+			current_id = new_id();
+		}
+		std::filesystem::path source = path;
+		auto relative = source.lexically_relative(root);
+		if (relative.empty() || relative.native().starts_with(std::filesystem::path("..").native())) {
+			events::error(qpl::to_string("SNAPSHOT : ", path, " is outside of ", root, "."));
+			return;
+		}
+		auto target = directory(root) / current_id / relative;
+
+		std::error_code error;
+		if (std::filesystem::is_directory(source, error)) {
+			for (auto it = std::filesystem::recursive_directory_iterator(source, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+				if (it->is_regular_file(error) && !preserve_file(it->path(), target / it->path().lexically_relative(source), link)) {
+					events::error(qpl::to_string("SNAPSHOT : couldn't keep ", it->path().string(), "."));
+				}
+			}
+		}
+		else if (!preserve_file(source, target, link)) {
+			events::error(qpl::to_string("SNAPSHOT : couldn't keep ", path, "."));
+		}
+	}
+
+	//ids of all snapshots under root, oldest first.
+	std::vector<std::string> list(const std::filesystem::path& root) {
+		std::vector<std::string> result;
+		std::error_code error;
+		for (auto it = std::filesystem::directory_iterator(directory(root), error); !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+			if (it->is_directory()) {
+				result.push_back(it->path().filename().string());
+			}
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+	qpl::size file_count(const std::filesystem::path& root, const std::string& id) {
+		qpl::size count = 0u;
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(directory(root) / id, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+			count += it->is_regular_file();
+		}
+		return count;
+	}
+
+	//copies every file of the snapshot back to its place. files the sync added are left alone.
+	qpl::size restore(const std::filesystem::path& root, const std::string& id) {
+		auto source = directory(root) / id;
+		qpl::size count = 0u;
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(source, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+			if (!it->is_regular_file()) {
+				continue;
+			}
+			auto target = root / it->path().lexically_relative(source);
+			std::error_code copy_error;
+			std::filesystem::create_directories(target.parent_path(), copy_error);
+			std::filesystem::copy_file(it->path(), target, std::filesystem::copy_options::overwrite_existing, copy_error);
+			if (copy_error) {
+				events::error(qpl::to_string("RESTORE : couldn't restore ", target.string(), " : ", copy_error.message()));
+			}
+			else {
+				++count;
+			}
+		}
+		return count;
+	}
+
+	//removes all but the newest keep snapshots under root, returns how many were removed.
+	qpl::size prune(const std::filesystem::path& root, qpl::size keep) {
+		auto ids = list(root);
+		qpl::size removed = 0u;
+		for (qpl::size i = 0u; i + keep < ids.size(); ++i) {
+			std::error_code error;
+			std::filesystem::remove_all(directory(root) / ids[i], error);
+			removed += !error;
+		}
+		return removed;
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "state.hpp"
+#include "events.hpp"
+#include "hash.hpp"
+#include "walker.hpp"
+#include "throttle.hpp"
+
+//result of a check-mode move computed while the prompt was idle. it is valid for as long as
+//the stat fingerprint of both trees hasn't changed.
+struct speculative_move {
+	bool valid = false;
+	::detection detection = detection::full;
+	qpl::u64 fingerprint = 0u;
+	std::vector<event> events;
+	history_status history;
+	qpl::size changes = 0u;
+};
+
+namespace speculation {
+	//held by the idle pass for one directory at a time and by every foreground command.
+	std::mutex mutex;
+
+	//names, sizes and write times of the whole tree. .git is skipped, fetches don't change the work tree.
+	qpl::u64 fingerprint(const std::string& directory, qpl::u64 hash = hash_seed) {
+		for (auto& entry : read_directory(directory)) {
+			if (entry.directory && entry.name == ".git") {
+				continue;
+			}
+			hash = hash_bytes(entry.name.data(), entry.name.size(), hash);
+			hash = hash_mix(hash ^ entry.size) + static_cast<qpl::u64>(entry.time.time_since_epoch().count());
+			if (entry.directory) {
+				hash = fingerprint(directory + entry.name + '/', hash_mix(hash + 1u));
+			}
+		}
+		return hash;
+	}
+	qpl::u64 fingerprint(const std::pair<std::string, std::string>& roots) {
+		return hash_mix(fingerprint(roots.first) ^ (fingerprint(roots.second) * 3u));
+	}
+
+	//replays a speculative result into history as if the move had just run with state.
+	void replay(const speculative_move& move, const state& state, history_status& history) {
+		for (auto& event : move.events) {
+			if (state.print || event.type == event_type::error) {
+				events::emit(event);
+			}
+		}
+		history.checked = move.history.checked;
+		history.move_changes = move.history.move_changes;
+		history.scanned_bytes = move.history.scanned_bytes;
+		history.scanned_files = move.history.scanned_files;
+		move.history.time_overwrites.for_each([&](const std::string& string) {
+			history.time_overwrites.push_back(string);
+		});
+		move.history.data_overwrites.for_each([&](const std::string& string) {
+			history.data_overwrites.push_back(string);
+		});
+		move.history.removes.for_each([&](const std::string& string) {
+			history.removes.push_back(string);
+		});
+		info::total_change_sum += move.changes;
+	}
+
+	//runs pass() once at start and again after every wake(). the pass itself checks running() between directories.
+	struct worker {
+		std::thread thread;
+		std::mutex wake_mutex;
+		std::condition_variable condition;
+		std::atomic_bool running = false;
+		bool pending = false;
+
+		~worker() {
+			this->stop();
+		}
+		void start(std::function<void()> pass) {
+			this->stop();
+			this->running = true;
+			this->pending = true;
+			this->thread = std::thread([this, pass = std::move(pass)]() {
+				throttle::enter_background();
+				while (true) {
+					{
+						std::unique_lock lock(this->wake_mutex);
+						this->condition.wait(lock, [&]() {
+							return this->pending || !this->running;
+						});
+						if (!this->running) {
+							return;
+						}
+						this->pending = false;
+					}
+					pass();
+				}
+			});
+		}
+		void wake() {
+			{
+				std::lock_guard lock(this->wake_mutex);
+				this->pending = true;
+			}
+			this->condition.notify_all();
+		}
+		void stop() {
+			if (!this->running) {
+				return;
+			}
+			{
+				std::lock_guard lock(this->wake_mutex);
+				this->running = false;
+			}
+			this->condition.notify_all();
+			this->thread.join();
+		}
+	};
+
+	worker background;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include "database.hpp"
+
+namespace spill {
+	//bytes a single list may keep in memory before it writes a sorted run to disk. 0 = unlimited.
+	qpl::size memory_limit = 0u;
+	std::atomic_size_t run_counter = 0u;
+
+	std::filesystem::path directory() {
+		return local_database::directory() / "spill";
+	}
+}
+
+struct spill_run {
+	std::filesystem::path path;
+
+	~spill_run() {
+		std::error_code error;
+		std::filesystem::remove(this->path, error);
+	}
+};
+
+//append-only string list with a memory ceiling. past the ceiling the in-memory part is sorted and written
+//to a run file; iterating then merges all runs, so the order is sorted instead of insertion order.
+struct spill_list {
+	std::vector<std::string> memory;
+	std::vector<std::shared_ptr<spill_run>> runs;
+	qpl::size memory_bytes = 0u;
+	qpl::size count = 0u;
+
+	void push_back(std::string string) {
+		this->memory_bytes += sizeof(std::string) + string.capacity();
+		this->memory.push_back(std::move(string));
+		++this->count;
+		if (spill::memory_limit && this->memory_bytes > spill::memory_limit) {
+			this->spill();
+		}
+	}
+	void spill() {
+		std::error_code error;
+		std::filesystem::create_directories(spill::directory(), error);
+
+		auto run = std::make_shared<spill_run>();
+		run->path = spill::directory() / qpl::to_string(std::chrono::steady_clock::now().time_since_epoch().count(), '_', spill::run_counter++, ".run");
+
+		std::sort(this->memory.begin(), this->memory.end());
+		std::ofstream file(run->path, std::ios::trunc);
+		for (auto& string : this->memory) {
+			file << string << '\n';
+		}
+		this->runs.push_back(run);
+		this->memory.clear();
+		this->memory.shrink_to_fit();
+		this->memory_bytes = 0u;
+	}
+	qpl::size size() const {
+		return this->count;
+	}
+	bool empty() const {
+		return this->count == 0u;
+	}
+	void clear() {
+		this->memory.clear();
+		this->runs.clear();
+		this->memory_bytes = 0u;
+		this->count = 0u;
+	}
+
+	template<typename F>
+	void for_each(F&& function) const {
+		if (this->runs.empty()) {
+			for (auto& string : this->memory) {
+				function(string);
+			}
+			return;
+		}
+
+		auto sorted = this->memory;
+		std::sort(sorted.begin(), sorted.end());
+
+		std::vector<std::ifstream> files;
+		for (auto& run : this->runs) {
+			files.emplace_back(run->path);
+		}
+
+		//(line, source) where source == files.size() is the in-memory part
+		using head = std::pair<std::string, qpl::size>;
+		std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+		qpl::size memory_index = 0u;
+
+		auto advance = [&](qpl::size source) {
+			if (source == files.size()) {
+				if (memory_index < sorted.size()) {
+					heads.push(std::make_pair(sorted[memory_index++], source));
+				}
+			}
+			else {
+				std::string line;
+				if (std::getline(files[source], line)) {
+					heads.push(std::make_pair(std::move(line), source));
+				}
+			}
+		};
+		for (qpl::size i = 0u; i <= files.size(); ++i) {
+			advance(i);
+		}
+		while (!heads.empty()) {
+			auto top = heads.top();
+			heads.pop();
+			function(top.first);
+			advance(top.second);
+		}
+	}
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include "state.hpp"
+#include "events.hpp"
+#include "parallel.hpp"
+#include "progress.hpp"
+#include "chunked.hpp"
+
+//copies every queued file into "<root>/.autogit_staging/" in parallel, then renames them over their destinations.
+//nothing is renamed if any copy fails and no destination is ever half written. a rename that fails part way leaves
+//the earlier destinations replaced and the later ones untouched: false is returned and the queue is kept for the caller.
+bool apply_staged_copies(const std::filesystem::path& root, history_status& history) {
+	if (history.staged_copies.empty()) {
+		return true;
+	}
+	std::error_code error;
+	auto staging = root / ".autogit_staging";
+	std::filesystem::remove_all(staging, error);
+	std::filesystem::create_directories(staging, error);
+	if (error) {
+		events::error(qpl::to_string("STAGING : couldn't create ", staging.string(), " : ", error.message()));
+		return false;
+	}
+
+	auto& copies = history.staged_copies;
+	std::vector<std::filesystem::path> temps(copies.size());
+	for (qpl::size i = 0u; i < copies.size(); ++i) {
+		temps[i] = staging / std::to_string(i);
+	}
+
+	std::atomic_bool failed = false;
+	parallel_for(copies.size(), [&](qpl::size index) {
+		if (failed) {
+			return;
+		}
+		std::error_code error;
+		auto size = std::filesystem::file_size(copies[index].first, error);
+		if (error) {
+			failed = true;
+			events::error(qpl::to_string("STAGING : couldn't read ", copies[index].first, " : ", error.message()));
+			return;
+		}
+		throttle::io(size);
+		if (chunked_copy::eligible(size)) {
+			auto result = chunked_copy::copy(copies[index].first, temps[index].string(), size);
+			if (!result.success) {
+				failed = true;
+				events::error(qpl::to_string("STAGING : couldn't copy ", copies[index].first, " : ", result.error));
+			}
+			return;
+		}
+		std::filesystem::copy_file(copies[index].first, temps[index], std::filesystem::copy_options::overwrite_existing, error);
+		if (!error) {
+			progress::copied(size);
+			auto time = std::filesystem::last_write_time(copies[index].first, error);
+			if (!error) {
+				std::filesystem::last_write_time(temps[index], time, error);
+			}
+		}
+		if (error) {
+			failed = true;
+			events::error(qpl::to_string("STAGING : couldn't copy ", copies[index].first, " : ", error.message()));
+		}
+	});
+
+	if (!failed) {
+		for (qpl::size i = 0u; i < copies.size(); ++i) {
+			std::filesystem::rename(temps[i], copies[i].second, error);
+			if (error) {
+				failed = true;
+				events::error(qpl::to_string("STAGING : couldn't replace ", copies[i].second, " : ", error.message()));
+				break;
+			}
+		}
+	}
+	std::filesystem::remove_all(staging, error);
+	if (!failed) {
+		copies.clear();
+	}
+	return !failed;
+}
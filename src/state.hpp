@@ -1,5 +1,9 @@
 #pragma once
 
+#include "spill.hpp"
+#include "porcelain.hpp"
+#include "prefetch.hpp"
+
 enum class action {
 	push,
 	pull,
@@ -10,6 +14,18 @@ enum class location {
 	git,
 	both
 };
+enum class render_mode {
+	console,
+	quiet,
+	json
+};
+enum class detection {
+	configured,
+	stat,
+	stat_inode,
+	cached_hash,
+	full
+};
 enum class command {
 	exe = 0,
 	move,
@@ -55,6 +71,17 @@ struct status {
 	}
 };
 
+constexpr auto detection_string(detection detection) {
+	switch (detection) {
+	case detection::configured: return "configured";
+	case detection::stat: return "stat";
+	case detection::stat_inode: return "inode";
+	case detection::cached_hash: return "hash";
+	case detection::full: return "full";
+	}
+	return "";
+}
+
 constexpr auto command_string(command command) {
 	switch (command) {
 	case command::exe: return "EXE";
@@ -70,11 +97,29 @@ struct state {
 	bool only_conflicts = false;
 	bool find_collisions = true;
 	bool status = false;
-	bool quick_mode = false;
 	bool update = false;
 	bool hard_pull = false;
+	bool staged = false;
+	bool streaming = false;
+	bool concurrent = false;
+	bool report = false;
+	bool snapshot = false;
+	bool restore = false;
+	bool list_snapshots = false;
+	bool prune = false;
+	std::string restore_id;
+	qpl::size snapshot_keep = 0u;
+	qpl::size memory_limit = 0u;
+	qpl::size fetch_window = prefetch::default_window;
+	qpl::size io_bytes_limit = 0u;
+	qpl::size io_operations_limit = 0u;
+	std::optional<qpl::size> chunk_threshold;
+	qpl::size copy_threads = 0u;
+	bool verify_copies = false;
 	::action action = action::both;
 	::location location = location::both;
+	::render_mode render = render_mode::console;
+	::detection detection = detection::configured;
 	std::vector<std::string> target_input_directories;
 
 	void reset() {
@@ -83,11 +128,29 @@ struct state {
 		this->only_conflicts = false;
 		this->find_collisions = true;
 		this->status = false;
-		this->quick_mode = false;
 		this->update = false;
 		this->hard_pull = false;
+		this->staged = false;
+		this->streaming = false;
+		this->concurrent = false;
+		this->report = false;
+		this->snapshot = false;
+		this->restore = false;
+		this->list_snapshots = false;
+		this->prune = false;
+		this->restore_id.clear();
+		this->snapshot_keep = 0u;
+		this->memory_limit = 0u;
+		this->fetch_window = prefetch::default_window;
+		this->io_bytes_limit = 0u;
+		this->io_operations_limit = 0u;
+		this->chunk_threshold.reset();
+		this->copy_threads = 0u;
+		this->verify_copies = false;
 		this->action = action::both;
 		this->location = location::both;
+		this->render = render_mode::console;
+		this->detection = detection::configured;
 		this->target_input_directories.clear();;
 
 	}
@@ -96,33 +159,44 @@ struct state {
 struct history_status {
 	bool move_changes = false;
 	bool git_changes = false;
-	bool any_output = false;
+	//the staged copies of the last move were not all applied.
+	bool apply_failed = false;
+	qpl::u64 scanned_bytes = 0u;
+	qpl::u64 scanned_files = 0u;
+	git_status git;
 
 	std::unordered_set<std::string> checked;
 	std::unordered_set<std::string> ignore;
-	std::vector<std::string> data_overwrites;
-	std::vector<std::string> time_overwrites;
-	std::vector<std::string> removes;
+	spill_list data_overwrites;
+	spill_list time_overwrites;
+	spill_list removes;
+	std::vector<std::pair<std::string, std::string>> staged_copies;
+	std::string root;
 
 	void reset() {
 		this->move_changes = false;
 		this->git_changes = false;
+		this->apply_failed = false;
 		this->data_overwrites.clear();
 		this->time_overwrites.clear();
 		this->removes.clear();
 	}
-
-	void command_reset() {
-		this->any_output = false;
-	}	
 	bool any_serious_collisions() {
 		return this->data_overwrites.size() || this->removes.size();
 	}
 	bool any_collisions() {
 		return this->any_serious_collisions() || this->time_overwrites.size();
 	}
+	//listings and the mirrored walker may spell separators differently, keys are compared with '/' only.
+	static std::string checked_key(std::string path) {
+		std::replace(path.begin(), path.end(), '\\', '/');
+		return path;
+	}
+	void check(const std::string& path) {
+		this->checked.insert(checked_key(path));
+	}
 	bool find_checked(std::string str) {
-		return this->checked.find(str) != this->checked.cend();
+		return this->checked.find(checked_key(std::move(str))) != this->checked.cend();
 	}
 	bool find_ignored_root(qpl::filesys::path path) {
 		for (auto& i : this->ignore) {
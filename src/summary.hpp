@@ -0,0 +1,140 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include "state.hpp"
+#include "database.hpp"
+#include "hash.hpp"
+#include "walker.hpp"
+
+//entry count and an order independent hash of (name, type, size, mtime) of every direct child. adding, removing
+//or renaming a child changes it like the directory mtime would, rewriting a file changes it as well.
+struct directory_summary {
+	qpl::size count = 0u;
+	qpl::u64 hash = 0u;
+
+	void add(const entry_stat& entry) {
+		auto hash = hash_bytes(entry.name.data(), entry.name.size());
+		hash = hash_mix(hash ^ entry.size ^ (qpl::u64{ entry.directory } << 63));
+		hash = hash_mix(hash + static_cast<qpl::u64>(entry.time.time_since_epoch().count()));
+		this->hash += hash;
+		++this->count;
+	}
+	bool operator==(const directory_summary& other) const = default;
+};
+
+namespace summary_cache {
+	//source directory -> count and hash of the source side, then of the destination side, as of the last run that
+	//found the pair in sync.
+	local_database summaries("summaries");
+	//working directory -> unix seconds of the last walk that didn't prune.
+	local_database full_walks("full_walks");
+
+	std::optional<std::pair<directory_summary, directory_summary>> find(const std::string& directory) {
+		auto fields = summaries.find(directory);
+		if (!fields.has_value() || fields->size() != 4u) {
+			return std::nullopt;
+		}
+		try {
+			std::pair<directory_summary, directory_summary> result;
+			result.first.count = std::stoull(fields->at(0u));
+			result.first.hash = std::stoull(fields->at(1u));
+			result.second.count = std::stoull(fields->at(2u));
+			result.second.hash = std::stoull(fields->at(3u));
+			return result;
+		}
+		catch (...) {
+			return std::nullopt;
+		}
+	}
+	void record(const std::string& directory, const directory_summary& source, const directory_summary& destination) {
+		summaries.set(directory, { std::to_string(source.count), std::to_string(source.hash), std::to_string(destination.count), std::to_string(destination.hash) });
+	}
+	void forget(const std::string& directory) {
+		summaries.remove(directory);
+	}
+
+	qpl::i64 now_seconds() {
+		return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+	//pruning skips content checks of unchanged directories, every prune_days one walk visits everything again.
+	bool full_walk_due(const std::string& path, qpl::size prune_days) {
+		auto fields = full_walks.find(path);
+		if (!fields.has_value() || fields->empty()) {
+			return true;
+		}
+		try {
+			return now_seconds() - std::stoll(fields->front()) >= qpl::i64(prune_days) * 24 * 60 * 60;
+		}
+		catch (...) {
+			return true;
+		}
+	}
+	void record_full_walk(const std::string& path) {
+		full_walks.set(path, { std::to_string(now_seconds()) });
+	}
+	void save() {
+		summaries.save();
+		full_walks.save();
+	}
+}
+
+//walk_mirrored hooks. a directory whose both sides still match the summaries of a run that found it in sync
+//has its entries marked as checked without comparing them, subdirectories are still listed since their changes
+//don't show up in the parent. directories that needed no work this run are recorded for the next one.
+struct directory_pruning {
+	const ::state& state;
+	history_status& history;
+	directory_summary source;
+	directory_summary destination;
+	bool pruned = false;
+	bool in_sync = false;
+	bool changes = false;
+
+	directory_pruning(const ::state& state, history_status& history) : state(state), history(history) {
+
+	}
+
+	bool enter(const std::string& source_directory, const std::string& destination_directory, const std::vector<entry_stat>& source_entries, const std::unordered_map<std::string, entry_stat>& destination_entries) {
+		this->source = {};
+		this->destination = {};
+		qpl::size matched = 0u;
+		for (auto& entry : source_entries) {
+			this->source.add(entry);
+			matched += destination_entries.contains(entry.name);
+		}
+		for (auto& [name, entry] : destination_entries) {
+			this->destination.add(entry);
+		}
+		//a destination entry without a source is a pending removal, that directory isn't in sync.
+		this->in_sync = matched == destination_entries.size();
+
+		this->pruned = false;
+		if (this->in_sync && this->state.prune) {
+			auto stored = summary_cache::find(source_directory);
+			this->pruned = stored.has_value() && stored->first == this->source && stored->second == this->destination;
+		}
+		if (this->pruned) {
+			if (!this->state.streaming) {
+				for (auto& entry : source_entries) {
+					this->history.check(destination_directory + (entry.directory ? entry.name + '/' : entry.name));
+				}
+			}
+			return true;
+		}
+		this->changes = this->history.move_changes;
+		this->history.move_changes = false;
+		return false;
+	}
+	void leave(const std::string& source_directory) {
+		if (this->pruned) {
+			return;
+		}
+		if (this->in_sync && !this->history.move_changes) {
+			summary_cache::record(source_directory, this->source, this->destination);
+		}
+		else {
+			summary_cache::forget(source_directory);
+		}
+		this->history.move_changes = this->history.move_changes || this->changes;
+	}
+};
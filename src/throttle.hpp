@@ -0,0 +1,109 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <qpl/winsys.hpp>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//token buckets around copies, content compares and removals. interactive commands are unlimited unless
+//"limit=" / "iops=" is given, background work (prefetch, speculative status) always runs in the background profile.
+namespace throttle {
+	//longest single sleep, a background thread notices a waiting foreground command within this many seconds.
+	constexpr qpl::f64 sleep_slice = 0.05;
+
+	//set while a foreground command waits for background work to finish, that work then runs unthrottled.
+	std::atomic_bool foreground_waiting = false;
+
+	struct token_bucket {
+		std::mutex mutex;
+		qpl::f64 rate = 0.0;
+		qpl::f64 tokens = 0.0;
+		std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+
+		//rate per second, 0 = unlimited. one second worth of tokens can be spent as a burst.
+		void set(qpl::f64 rate) {
+			std::lock_guard lock(this->mutex);
+			this->rate = rate;
+			this->tokens = rate;
+			this->last = std::chrono::steady_clock::now();
+		}
+		//takes amount tokens and sleeps off any debt outside the lock, so one large request never blocks other threads.
+		//the sleep is sliced, once cancel is set the rest of the debt stays in the bucket and the caller goes on.
+		void acquire(qpl::f64 amount, const std::atomic_bool* cancel = nullptr) {
+			qpl::f64 wait = 0.0;
+			{
+				std::lock_guard lock(this->mutex);
+				if (this->rate <= 0.0) {
+					return;
+				}
+				auto now = std::chrono::steady_clock::now();
+				this->tokens = qpl::min(this->rate, this->tokens + std::chrono::duration<qpl::f64>(now - this->last).count() * this->rate);
+				this->last = now;
+				this->tokens -= amount;
+				if (this->tokens < 0.0) {
+					wait = -this->tokens / this->rate;
+				}
+			}
+			while (wait > 0.0 && !(cancel && *cancel)) {
+				auto slice = qpl::min(wait, sleep_slice);
+				std::this_thread::sleep_for(std::chrono::duration<qpl::f64>(slice));
+				wait -= slice;
+			}
+		}
+	};
+
+	struct profile {
+		token_bucket bytes;
+		token_bucket operations;
+
+		profile(qpl::f64 bytes_per_second = 0.0, qpl::f64 operations_per_second = 0.0) {
+			this->set(bytes_per_second, operations_per_second);
+		}
+
+		void set(qpl::f64 bytes_per_second, qpl::f64 operations_per_second) {
+			this->bytes.set(bytes_per_second);
+			this->operations.set(operations_per_second);
+		}
+	};
+
+	constexpr qpl::f64 background_bytes = 16.0 * (1u << 20);
+	constexpr qpl::f64 background_operations = 200.0;
+
+	profile interactive;
+	profile background(background_bytes, background_operations);
+
+	thread_local bool background_thread = false;
+
+	//one copy, compare or remove of bytes. called before the operation touches the disk.
+	void io(qpl::u64 bytes) {
+		if (background_thread && foreground_waiting) {
+			return;
+		}
+		auto& current = background_thread ? background : interactive;
+		auto cancel = background_thread ? &foreground_waiting : nullptr;
+		current.operations.acquire(1.0, cancel);
+		if (bytes) {
+			current.bytes.acquire(static_cast<qpl::f64>(bytes), cancel);
+		}
+	}
+
+	//moves the calling thread to the background profile and the idle I/O class of the OS.
+	void enter_background() {
+		background_thread = true;
+#if defined(_WIN32)
+		SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__) && defined(SYS_ioprio_set)
+		constexpr int ioprio_who_process = 1;
+		constexpr int ioprio_class_idle = 3;
+		constexpr int ioprio_class_shift = 13;
+		::syscall(SYS_ioprio_set, ioprio_who_process, static_cast<int>(::syscall(SYS_gettid)), ioprio_class_idle << ioprio_class_shift);
+#endif
+	}
+}
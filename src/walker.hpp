@@ -0,0 +1,163 @@
+#pragma once
+
+#include <qpl/qpl.hpp>
+
+#if defined(_WIN32)
+#include <qpl/winsys.hpp>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//everything perform_move needs to know about one side, filled in by the directory listing itself.
+struct entry_stat {
+	std::string name;
+	bool directory = false;
+	qpl::u64 size = 0u;
+	std::filesystem::file_time_type time;
+};
+
+#if defined(_WIN32)
+//FindFirstFileEx returns type, size and write time with the listing, no per-file call is needed.
+std::vector<entry_stat> read_directory(std::string directory) {
+	std::vector<entry_stat> result;
+	if (directory.empty() || (directory.back() != '/' && directory.back() != '\\')) {
+		directory.push_back('/');
+	}
+	WIN32_FIND_DATAA data;
+	auto handle = FindFirstFileExA((directory + '*').c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return result;
+	}
+	do {
+		std::string_view name = data.cFileName;
+		if (name == "." || name == "..") {
+			continue;
+		}
+		entry_stat entry;
+		entry.name = name;
+		entry.directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = (qpl::u64{ data.nFileSizeHigh } << 32) | data.nFileSizeLow;
+		auto ticks = (qpl::u64{ data.ftLastWriteTime.dwHighDateTime } << 32) | data.ftLastWriteTime.dwLowDateTime;
+		entry.time = std::filesystem::file_time_type(std::filesystem::file_time_type::duration(ticks));
+		result.push_back(std::move(entry));
+	} while (FindNextFileA(handle, &data));
+	FindClose(handle);
+	return result;
+}
+#else
+//one open per directory, then every entry is stat'ed relative to that directory fd.
+std::vector<entry_stat> read_directory(const std::string& directory) {
+	std::vector<entry_stat> result;
+	auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		return result;
+	}
+	auto dir = ::fdopendir(fd);
+	if (!dir) {
+		::close(fd);
+		return result;
+	}
+	while (auto entry = ::readdir(dir)) {
+		std::string_view name = entry->d_name;
+		if (name == "." || name == "..") {
+			continue;
+		}
+		entry_stat stat;
+		stat.name = name;
+		qpl::i64 ns = 0;
+#if defined(STATX_TYPE)
+		struct statx info;
+		if (::statx(fd, entry->d_name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE | STATX_MTIME, &info) != 0) {
+			continue;
+		}
+		stat.directory = S_ISDIR(info.stx_mode);
+		stat.size = info.stx_size;
+		ns = qpl::i64{ info.stx_mtime.tv_sec } * 1'000'000'000 + info.stx_mtime.tv_nsec;
+#else
+		struct stat info;
+		if (::fstatat(fd, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+			continue;
+		}
+		stat.directory = S_ISDIR(info.st_mode);
+		stat.size = static_cast<qpl::u64>(info.st_size);
+		ns = qpl::i64{ info.st_mtim.tv_sec } * 1'000'000'000 + info.st_mtim.tv_nsec;
+#endif
+		auto sys = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(ns));
+		stat.time = std::chrono::time_point_cast<std::filesystem::file_time_type::duration>(std::chrono::file_clock::from_sys(sys));
+		result.push_back(std::move(stat));
+	}
+	::closedir(dir);
+	return result;
+}
+#endif
+
+struct move_entry {
+	qpl::filesys::path source;
+	qpl::filesys::path destination;
+	entry_stat source_stat;
+	std::optional<entry_stat> destination_stat;
+};
+
+//walker hooks that never prune, enter() returning true skips the callbacks of that directory's own entries.
+struct no_pruning {
+	bool enter(const std::string&, const std::string&, const std::vector<entry_stat>&, const std::unordered_map<std::string, entry_stat>&) {
+		return false;
+	}
+	void leave(const std::string&) {
+
+	}
+};
+
+//walks the source subtree and its mirror side by side. each directory of either tree is listed exactly once,
+//mirror paths are built by appending names instead of rebuilding every path with with_branch.
+//destination entries without a source counterpart are passed to removed(path, stat) once their directory is done.
+//a directory's own entries are all handed to callback before its subdirectories are walked, so pruning.leave()
+//sees exactly the work done for that one directory.
+template<typename F, typename R, typename P = no_pruning>
+void walk_mirrored(const std::string& source_directory, const std::string& destination_directory, bool destination_exists, F&& callback, R&& removed, P&& pruning = P{}) {
+	auto source_entries = read_directory(source_directory);
+
+	std::unordered_map<std::string, entry_stat> destination_entries;
+	if (destination_exists) {
+		for (auto& entry : read_directory(destination_directory)) {
+			auto name = entry.name;
+			destination_entries.emplace(std::move(name), std::move(entry));
+		}
+	}
+	bool skip = pruning.enter(source_directory, destination_directory, source_entries, destination_entries);
+
+	std::vector<std::pair<std::string, bool>> subdirectories;
+	for (auto& entry : source_entries) {
+		auto suffix = entry.directory ? entry.name + '/' : entry.name;
+		auto source_path = source_directory + suffix;
+
+		move_entry item;
+		item.source = source_path;
+		item.destination = destination_directory + suffix;
+		auto found = destination_entries.find(entry.name);
+		if (found != destination_entries.cend()) {
+			item.destination_stat = std::move(found->second);
+			destination_entries.erase(found);
+		}
+		item.source_stat = std::move(entry);
+
+		if (item.source_stat.directory) {
+			subdirectories.emplace_back(suffix, item.destination_stat.has_value() && item.destination_stat->directory);
+		}
+		if (!skip) {
+			callback(item);
+		}
+	}
+	for (auto& [name, entry] : destination_entries) {
+		removed(destination_directory + (entry.directory ? name + '/' : name), entry);
+	}
+	pruning.leave(source_directory);
+
+	for (auto& [suffix, exists] : subdirectories) {
+		walk_mirrored(source_directory + suffix, destination_directory + suffix, exists, callback, removed, pruning);
+	}
+}
+